@@ -6,6 +6,8 @@
 #include <vector>
 #include <cstdint>
 #include "omnigraph.hpp"
+#include "readsDecoder.hpp"
+#include "runMetrics.hpp"
 #include <cassert>
 //#include "progressbar.hpp"
 //#include "tqdm.h"
@@ -63,11 +65,8 @@ int main(int argc, char **argv) {
     string header = "ID\tR\tfound_kmers%\tscenario\n";
     detailed_stats_file->write(header);
 
-    kmerDecoder *READ_1_KMERS = new Kmers(PE_1_reads_file, batchSize, kSize);
-    kmerDecoder *READ_2_KMERS = new Kmers(PE_2_reads_file, batchSize, kSize);
-
-    READ_1_KMERS->setHashingMode(hashing_mode);
-    READ_2_KMERS->setHashingMode(hashing_mode);
+    auto *READ_1_KMERS = new readsDecoder(PE_1_reads_file, batchSize, kSize, hashing_mode);
+    auto *READ_2_KMERS = new readsDecoder(PE_2_reads_file, batchSize, kSize, hashing_mode);
 
     // Initializations
     int no_chunks = ceil((double) no_of_sequences / (double) batchSize);
@@ -84,37 +83,41 @@ int main(int argc, char **argv) {
     while (!READ_1_KMERS->end() && !READ_2_KMERS->end()) {
 
         cerr << "processing chunk: (" << ++current_chunk << ") / (" << no_chunks << ") ... ";
-        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+        scopedTimer chunk_timer(nullptr, "chunk_ms");
 
+        double io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms();
+        double parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms;
         READ_1_KMERS->next_chunk();
         READ_2_KMERS->next_chunk();
+        io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms() - io_wait;
+        parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms - parse_time;
 
 
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1 = READ_1_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2 = READ_2_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1_end = READ_1_KMERS->getKmers()->end();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2_end = READ_2_KMERS->getKmers()->end();
+        auto seq1 = READ_1_KMERS->getReads()->begin();
+        auto seq2 = READ_2_KMERS->getReads()->begin();
+        auto seq1_end = READ_1_KMERS->getReads()->end();
+        auto seq2_end = READ_2_KMERS->getReads()->end();
 
         vector<tuple<string, int, double, int>> detailed_chunk_stats;
         // tuple<seq, matched, scenario, component, found_ratio>
         // read_id      R1orR2      found_ratio     scenario_id(3,4,5,6)
         while (seq1 != seq1_end && seq2 != seq2_end) {
-            tuple<string, bool, int, uint32_t, double> read_1_result = partitioner->classifyRead_withStats(kf,seq1->second,1);
-            tuple<string, bool, int, uint32_t, double> read_2_result = partitioner->classifyRead_withStats(kf,seq2->second,2);
+            tuple<string, bool, int, uint32_t, double> read_1_result = partitioner->classifyRead_withStats(kf,*seq1,1);
+            tuple<string, bool, int, uint32_t, double> read_2_result = partitioner->classifyRead_withStats(kf,*seq2,2);
 
             string read_1_constructedRead = get<0>(read_1_result);
 //            bool read_1_mapped_flag = get<1>(read_1_result);
             int read_1_scenario = get<2>(read_1_result);
 //            uint32_t read_1_collectiveComponent = get<3>(read_1_result);
             double read_1_found_ratio = get<4>(read_1_result);
-            detailed_chunk_stats.push_back(make_tuple(seq1->first, 1, read_1_found_ratio, read_1_scenario));
+            detailed_chunk_stats.push_back(make_tuple(seq1->name, 1, read_1_found_ratio, read_1_scenario));
 
             string read_2_constructedRead = get<0>(read_2_result);
 //            bool read_2_mapped_flag = get<1>(read_2_result);
             int read_2_scenario = get<2>(read_2_result);
 //            uint32_t read_2_collectiveComponent = get<3>(read_2_result);
             double read_2_found_ratio = get<4>(read_2_result);
-            detailed_chunk_stats.push_back(make_tuple(seq2->first, 2, read_2_found_ratio, read_2_scenario));
+            detailed_chunk_stats.push_back(make_tuple(seq2->name, 2, read_2_found_ratio, read_2_scenario));
 
             seq1++;
             seq2++;
@@ -130,16 +133,8 @@ int main(int argc, char **argv) {
         detailed_chunk_stats.clear();
 
 
-        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-        auto milli = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        long hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        long min = milli / 60000;
-        milli = milli - 60000 * min;
-        long sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cerr << "Done in: ";
-        cerr << min << ":" << sec << ":" << milli << endl;
+        cerr << "Done in: " << runMetrics::format_ms(chunk_timer.stop());
+        cerr << " (io wait: " << (long) io_wait << "ms, parse: " << (long) parse_time << "ms)" << endl;
     }
 
     cout << endl << endl;
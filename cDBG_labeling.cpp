@@ -1,27 +1,6 @@
-#include <parallel_hashmap/phmap.h>
 #include <string>
 #include <iostream>
-#include <cstdint>
-#include <kDataFrame.hpp>
-#include <algorithms.hpp>
-#include <algorithm>
-#include <progressbar.hpp>
-
-void parse_namesFile(const string &names_fileName, flat_hash_map<uint32_t, uint32_t> &groupNameMap) {
-    ifstream namesFile(names_fileName.c_str());
-    uint32_t componentID, unitigID;
-    string line;
-    while (std::getline(namesFile, line)) {
-        std::vector<string> tokens;
-        std::istringstream iss(line);
-        std::string token;
-        while (std::getline(iss, token, '\t'))   // but we can specify a different one
-            tokens.push_back(token);
-        unitigID = std::stoi(tokens[0].substr(0, tokens[0].find(' ')));
-        componentID = std::stoi(tokens[1]);
-        groupNameMap[unitigID] = componentID;
-    }
-}
+#include "cdbgLabeling.hpp"
 
 int main(int argc, char **argv) {
 
@@ -35,49 +14,13 @@ int main(int argc, char **argv) {
     const string output_prefix = argv[3];
 
     int kSize = 75;
-    int chunkSize = 100;
     int hashing_mode = 3;
 
-    flat_hash_map<uint32_t, uint32_t> unitig_to_component;
-
-    parse_namesFile(names_tsv, unitig_to_component);
-
-    auto *cDBG = new kDataFramePHMAP(75, hashing_mode);
-    kProcessor::kmerDecoder_setHashing(cDBG, hashing_mode);
-
-    int total_seqs = unitig_to_component.size();
-    int total_chunks = ceil((double) total_seqs / (double) chunkSize);
-
-    cerr << "total_seqs : " << total_seqs << endl;
-    cerr << "chunkSize: " << chunkSize << endl;
-    cerr << "total chunks: " << total_chunks << endl;
-
-    progressbar bar(total_chunks);
-    bar.set_done_char("█");
-
-    kmerDecoder *KD = new Kmers(fasta_file, chunkSize, kSize);
-    KD->setHashingMode(hashing_mode);
-    int original_inserted_kmers = 0;
-    while (!KD->end()) {
-        KD->next_chunk();
-        bar.update();
-        for (const auto &seq : *KD->getKmers()) {
-            for (const auto &kmer : seq.second) {
-                uint32_t unitig_id = std::stoi(seq.first.substr(0, seq.first.find(' ')));
-                original_inserted_kmers++;
-                cDBG->setCount(kmer.hash, unitig_to_component[unitig_id]);
-            }
-        }
-    }
-    cout << endl << endl;
-
-
-    cout << "number of lost kmers: original(" << original_inserted_kmers << ") - inserted(" << cDBG->size()
-         << ") = "
-         << original_inserted_kmers - cDBG->size() << endl;
+    kDataFrame *cDBG = label_cDBG(fasta_file, names_tsv, kSize, hashing_mode);
 
     cerr << "saving to disk ...: " << endl;
     cDBG->save(output_prefix);
+    delete cDBG;
 
 
     /* // Debugging
@@ -93,4 +36,4 @@ int main(int argc, char **argv) {
 
 
     return 0;
-}
\ No newline at end of file
+}
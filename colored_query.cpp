@@ -0,0 +1,130 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <omp.h>
+#include <kDataFrame.hpp>
+#include "readsDecoder.hpp"
+#include "coloredClassifier.hpp"
+
+using namespace std;
+
+/*
+ * Batch classification of a reads file against a colored kProcessor index (the native replacement of
+ * batchQuery_trial/batch_query.py). Every chunk is classified across threads, one coloredClassifier per thread,
+ * and written in input order as TSV: read, kmers, matched kmers, majority source, its votes, shared sources.
+ */
+
+int main(int argc, char **argv) {
+
+    if (argc < 3) {
+        cerr << "run: ./colored_query <colored_index_prefix> <reads.fa|reads.fq> [options]" << endl;
+        cerr << "options:" << endl;
+        cerr << "  --out <file>               (default: stdout)" << endl;
+        cerr << "  --threads <N>              (default: all cores)" << endl;
+        cerr << "  --chunk-size <N>           reads per chunk (default: 100000)" << endl;
+        cerr << "  --hashing-mode <N>         hashing mode of the index (default: kProcessor's)" << endl;
+        exit(1);
+    }
+
+    string index_prefix = argv[1];
+    string reads_file = argv[2];
+    string out_file;
+    int threads = omp_get_max_threads();
+    int chunk_size = 100000;
+    int hashing_mode = -1;
+
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--out" && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (option == "--threads" && i + 1 < argc) {
+            threads = max(1, stoi(argv[++i]));
+        } else if (option == "--chunk-size" && i + 1 < argc) {
+            chunk_size = max(1, stoi(argv[++i]));
+        } else if (option == "--hashing-mode" && i + 1 < argc) {
+            hashing_mode = stoi(argv[++i]);
+        } else {
+            cerr << "unknown option: " << option << endl;
+            exit(1);
+        }
+    }
+
+    auto t1 = chrono::high_resolution_clock::now();
+    cerr << "Loading colored index ..." << endl;
+    colored_kDataFrame *ckf = colored_kDataFrame::load(index_prefix);
+    kDataFrame *kf = ckf->getkDataFrame();
+    auto names = ckf->names_map();
+    size_t n_sources = 0;
+    for (const auto &name : names) n_sources = max(n_sources, (size_t) name.first + 1);
+    fprintf(stderr, "Colored index loaded: %lu sources, k = %lu\n", (unsigned long) names.size(),
+            (unsigned long) kf->getkSize());
+
+    mutex index_mutex;
+    vector<coloredClassifier *> classifiers(threads);
+    for (auto &classifier : classifiers) classifier = new coloredClassifier(ckf, &index_mutex, n_sources);
+
+    ofstream out_stream;
+    if (!out_file.empty()) out_stream.open(out_file);
+    ostream &out = out_file.empty() ? cout : out_stream;
+    out << "read\tkmers\tmatched_kmers\tsource\tvotes\tshared_sources\n";
+
+    auto source_name = [&names](uint32_t source) -> string {
+        auto it = names.find(source);
+        return it == names.end() ? to_string(source) : it->second;
+    };
+
+    readsDecoder reads(reads_file, chunk_size, (int) kf->getkSize(), hashing_mode);
+    vector<colored_result> results;
+    string buffer;
+    uint64_t total_reads = 0, classified_reads = 0;
+
+    while (!reads.end()) {
+        reads.next_chunk();
+        readsChunk *chunk = reads.getReads();
+        size_t n = chunk->size();
+        if (results.size() < n) results.resize(n);
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 1024)
+        for (size_t i = 0; i < n; i++) {
+            classifiers[omp_get_thread_num()]->classify(chunk->first[i], results[i]);
+        }
+
+        buffer.clear();
+        for (size_t i = 0; i < n; i++) {
+            const decoded_read &read = chunk->first[i];
+            const colored_result &result = results[i];
+            buffer.append(read.name, 0, read.name.find_first_of(" \t")).append("\t");
+            buffer.append(to_string(result.kmers)).append("\t").append(to_string(result.matched_kmers)).append("\t");
+            if (result.best_source == UINT32_MAX) {
+                buffer.append("-\t0\t-\n");
+                continue;
+            }
+            classified_reads++;
+            buffer.append(source_name(result.best_source)).append("\t").append(to_string(result.best_votes));
+            buffer.append("\t");
+            for (size_t s = 0; s < result.intersection.size(); s++) {
+                if (s) buffer.append(",");
+                buffer.append(source_name(result.intersection[s]));
+            }
+            if (result.intersection.empty()) buffer.append("-");
+            buffer.append("\n");
+        }
+        out.write(buffer.data(), buffer.size());
+        total_reads += n;
+    }
+
+    uint64_t cache_misses = 0;
+    for (auto &classifier : classifiers) {
+        cache_misses += classifier->cache_misses;
+        delete classifier;
+    }
+
+    auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "Classified %lu / %lu reads in %.1fs using %d threads (%lu color lookups).\n",
+            (unsigned long) classified_reads, (unsigned long) total_reads, sec, threads, (unsigned long) cache_misses);
+
+    delete ckf;
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <omp.h>
+#include "finalComponents.hpp"
+#include "finalCompsDumper.hpp"
+#include "pairsCount.hpp"
+
+using namespace std;
+
+/*
+ * Dumps the final components of a single partitioning run to <out_dir>/<finalComp>.fa, replacing
+ * scripts/dump_finalComps.py. The original -> final map is built in memory from the pairs counts
+ * (or loaded from _finalComponents.bin), then dumped by dump_final_components().
+ */
+
+int main(int argc, char **argv) {
+
+    string map_file = argc > 2 ? argv[2] : "";
+    bool binary_pairs = !map_file.empty() && pairs_count::is_binary(map_file);
+    bool binary_map = !binary_pairs && map_file.size() > 4 && map_file.compare(map_file.size() - 4, 4, ".bin") == 0;
+
+    if (argc < 3 || (argc < 4 && !binary_map)) {
+        cerr << "run: ./dump_finalComps <reads> <pairsCount.tsv|_pairsCount.bin> <originalComponents.csv> [options]" << endl;
+        cerr << "  or ./dump_finalComps <reads> <_finalComponents.bin> [options]" << endl;
+        cerr << "  <reads>: SQLite DB, columnar store directory (_omni.cols) or manifest (_omni.manifest)" << endl;
+        cerr << "  <_finalComponents.bin>: map computed by single_primaryPartitioning, --cutoff is ignored" << endl;
+        cerr << "options:" << endl;
+        cerr << "  --cutoff <N>               ignore pairs counts below N when merging components (default: 1)" << endl;
+        cerr << "  --threads <N>              number of writer threads (default: all cores)" << endl;
+        cerr << "  --out-dir <dir>            (default: dumped_partitions_cutoff<N>_<reads basename>)" << endl;
+        cerr << "  --max-open-files <N>       open partition files limit, shared by all threads (default: 512)" << endl;
+        cerr << "  --gzip-level <1-9>         write <finalComp>.fa.gz partitions (default: off)" << endl;
+        cerr << "  --gzip-threads <N>         compression worker threads (default: 4)" << endl;
+        cerr << "  --metrics <file>           write the run metrics as JSON (TSV for a .tsv file)" << endl;
+        cerr << "  --metrics-interval <sec>   also rewrite the metrics file periodically during the run" << endl;
+        exit(1);
+    }
+
+    string reads_path = argv[1];
+    string original_comps_file = binary_map ? "" : argv[3];
+    uint32_t cutoff = 1;
+    int threads = omp_get_max_threads();
+    string out_dir;
+    int max_open_files = 512;
+    int gzip_level = 0;
+    int gzip_threads = 4;
+    string metrics_file;
+    double metrics_interval = 0;
+
+    for (int i = binary_map ? 3 : 4; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--cutoff" && i + 1 < argc) {
+            cutoff = stoul(argv[++i]);
+        } else if (option == "--threads" && i + 1 < argc) {
+            threads = max(1, stoi(argv[++i]));
+        } else if (option == "--out-dir" && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (option == "--max-open-files" && i + 1 < argc) {
+            max_open_files = stoi(argv[++i]);
+        } else if (option == "--gzip-level" && i + 1 < argc) {
+            gzip_level = stoi(argv[++i]);
+        } else if (option == "--gzip-threads" && i + 1 < argc) {
+            gzip_threads = stoi(argv[++i]);
+        } else if (option == "--metrics" && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (option == "--metrics-interval" && i + 1 < argc) {
+            metrics_interval = stod(argv[++i]);
+        } else {
+            cerr << "unknown option: " << option << endl;
+            exit(1);
+        }
+    }
+
+    // --------------------------------------------------------------------------------
+    //                         Original -> final components map                       |
+    // --------------------------------------------------------------------------------
+
+    finalComponents components;
+    if (binary_map) {
+        components.binary_import(map_file);
+        cutoff = components.cutoff;
+    } else {
+        components = finalComponents(finalComponents::count_original_components(original_comps_file), cutoff);
+        if (binary_pairs) {
+            pairs_count pairs("");
+            pairs.binary_import(map_file);
+            pairs.for_each([&components](uint32_t comp1, uint32_t comp2, uint32_t count) {
+                components.add_pairs_count(comp1, comp2, count);
+            });
+        } else {
+            components.load_pairs_count(map_file);
+        }
+        components.construct();
+    }
+    cerr << "Final components: " << components.n_final << " (" << components.n_connected << " connected, "
+         << components.n_final - components.n_connected << " isolated, cutoff " << cutoff << ")" << endl;
+
+    if (out_dir.empty()) {
+        string base_name = reads_path.substr(reads_path.rfind('/') + 1);
+        if (base_name.size() > 3 && base_name.compare(base_name.size() - 3, 3, ".db") == 0) {
+            base_name.resize(base_name.size() - 3);
+        }
+        out_dir = "dumped_partitions_cutoff" + to_string(cutoff) + "_" + base_name;
+    }
+
+    runMetrics metrics(metrics_file, metrics_interval);
+    dump_options options;
+    options.metrics = &metrics;
+    options.out_dir = out_dir;
+    options.threads = threads;
+    options.max_open_files = max_open_files;
+    options.gzip_level = gzip_level;
+    options.gzip_threads = gzip_threads;
+    try {
+        dump_final_components(reads_path, components, options);
+    } catch (const runtime_error &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
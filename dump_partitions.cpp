@@ -0,0 +1,131 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <omp.h>
+#include "partitionManifest.hpp"
+#include "bucketWriterPool.hpp"
+
+using namespace std;
+
+/*
+ * Emits the per-component FASTA partitions of a manifest written by
+ * `single_primaryPartitioning --store manifest`, reading the records straight from the original R1/R2 files.
+ * Each thread owns the components with comp % threads == thread and scans the (mmapped) manifest,
+ * so every partition is written by a single thread, in input order. With --gzip-level the threads share
+ * one pool of compression workers.
+ * Scenario 5 reads are written whole, as they are in the input, the SQLite store keeps them trimmed.
+ */
+
+int main(int argc, char **argv) {
+
+    if (argc < 3) {
+        cerr << "run: ./dump_partitions <manifest> <out_dir> [options]" << endl;
+        cerr << "options:" << endl;
+        cerr << "  --threads <N>              number of writer threads (default: all cores)" << endl;
+        cerr << "  --max-open-files <N>       open partition files limit, shared by all threads (default: 512)" << endl;
+        cerr << "  --gzip-level <1-9>         write <comp>.fa.gz partitions (default: off)" << endl;
+        cerr << "  --gzip-threads <N>         compression worker threads (default: 4)" << endl;
+        exit(1);
+    }
+
+    string manifest_file = argv[1];
+    string out_dir = argv[2];
+    int threads = omp_get_max_threads();
+    int max_open_files = 512;
+    int gzip_level = 0;
+    int gzip_threads = 4;
+
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--threads" && i + 1 < argc) {
+            threads = max(1, stoi(argv[++i]));
+        } else if (option == "--max-open-files" && i + 1 < argc) {
+            max_open_files = stoi(argv[++i]);
+        } else if (option == "--gzip-level" && i + 1 < argc) {
+            gzip_level = stoi(argv[++i]);
+        } else if (option == "--gzip-threads" && i + 1 < argc) {
+            gzip_threads = stoi(argv[++i]);
+        } else {
+            cerr << "unknown option: " << option << endl;
+            exit(1);
+        }
+    }
+
+    auto t1 = chrono::high_resolution_clock::now();
+    manifestReader manifest(manifest_file);
+    cerr << "Manifest: " << manifest.n_pairs << " pairs\nR1: " << manifest.R1_file << "\nR2: " << manifest.R2_file
+         << endl;
+
+    int R1_fd = open(manifest.R1_file.c_str(), O_RDONLY);
+    int R2_fd = open(manifest.R2_file.c_str(), O_RDONLY);
+    if (R1_fd == -1 || R2_fd == -1) {
+        cerr << "could not open the reads files referenced by the manifest." << endl;
+        exit(1);
+    }
+
+    mkdir(out_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+
+    uint64_t written_reads = 0;
+    size_t files_per_thread = max(1, max_open_files / threads);
+    blockCompressor *compressor = gzip_level > 0 ? new blockCompressor(gzip_threads, gzip_level) : nullptr;
+    ofstream compression_report;
+    double compress_wait_ms = 0;
+    if (compressor) {
+        compression_report.open(out_dir + "/compression.tsv");
+        bucketWriterPool::report_header(compression_report);
+    }
+
+#pragma omp parallel num_threads(threads) reduction(+:written_reads, compress_wait_ms)
+    {
+        auto thread_id = (uint32_t) omp_get_thread_num();
+        auto n_threads = (uint32_t) omp_get_num_threads();
+        bucketWriterPool pool([&out_dir](uint64_t comp) { return out_dir + "/" + to_string(comp) + ".fa"; },
+                              files_per_thread);
+        if (compressor) pool.set_compressor(compressor);
+        vector<char> window(manifestReader::initial_window);
+        string seq, record;
+
+        auto emit = [&](int fd, uint64_t offset, uint64_t ID, int mate, uint32_t comp) {
+            if (!manifestReader::read_sequence(fd, offset, window, seq)) {
+#pragma omp critical
+                cerr << "could not read the record of pair " << ID << " at offset " << offset << endl;
+                return;
+            }
+            record.clear();
+            record.append(">").append(to_string(ID)).append(mate == 1 ? ".1\n" : ".2\n");
+            record.append(seq).append("\n");
+            pool.write(comp, record);
+            written_reads++;
+        };
+
+        for (uint64_t i = 0; i < manifest.n_pairs; i++) {
+            const manifest_record &pair = manifest.records[i];
+            if (pair.comp1 % n_threads == thread_id) emit(R1_fd, pair.offset1, i + 1, 1, pair.comp1);
+            if (pair.comp2 % n_threads == thread_id) emit(R2_fd, pair.offset2, i + 1, 2, pair.comp2);
+        }
+        pool.close_all();
+        compress_wait_ms += pool.compress_wait_ms;
+        if (compressor) {
+#pragma omp critical
+            pool.report(compression_report);
+        }
+    }
+
+    close(R1_fd);
+    close(R2_fd);
+
+    auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "Dumped %lu reads into %s in %.1fs using %d threads.\n", (unsigned long) written_reads,
+            out_dir.c_str(), sec, threads);
+    if (compressor) {
+        compressor->print_summary(compress_wait_ms);
+        delete compressor;
+    }
+
+    return 0;
+}
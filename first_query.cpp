@@ -7,6 +7,9 @@
 #include <firstQuery.hpp>
 #include "INIReader.h"
 #include "omnigraph.hpp"
+#include "readsDecoder.hpp"
+#include "batchTuner.hpp"
+#include "runMetrics.hpp"
 #include "assert.h"
 
 using namespace std;
@@ -15,7 +18,12 @@ int main(int argc, char **argv) {
 
     string config_file_path = "../config.ini";
     string index_prefix, PE_1_reads_file, PE_2_reads_file, sqlite_db;
-    int batchSize, kSize, no_of_sequences;
+    int batchSize, kSize, no_of_sequences, readahead_mb, hashing_mode, min_quality, max_chunk_mb;
+    double target_chunk_ms;
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--config") config_file_path = argv[i + 1];
+    }
 
     INIReader reader(config_file_path);
 
@@ -30,15 +38,21 @@ int main(int argc, char **argv) {
     PE_2_reads_file = reader.Get("Reads", "read2", "");
     no_of_sequences = reader.GetInteger("Reads", "seqs_no", 0);
     sqlite_db = reader.Get("SQLite", "db_file", "query1_result.db");
+    bool packed_seqs = reader.GetBoolean("SQLite", "packed_seqs", false);
+    bool persist_hashes = reader.GetBoolean("SQLite", "persist_hashes", false);
     batchSize = reader.GetInteger("kProcessor", "chunk_size", 1);
+    target_chunk_ms = reader.GetReal("kProcessor", "target_chunk_ms", 0);
+    max_chunk_mb = reader.GetInteger("kProcessor", "max_chunk_mb", 0);
     kSize = reader.GetInteger("kProcessor", "ksize", 31);
+    hashing_mode = reader.GetInteger("kProcessor", "hashing_mode", -1);
+    readahead_mb = reader.GetInteger("Reads", "readahead_mb", 64);
+    min_quality = reader.GetInteger("Reads", "min_quality", 0);
 
     // Temporary solutino for the Farm IO
-    if(argc == 3){
-        cerr << "scanning other sys args .. \n";
-        if(string(argv[1]) == "--db"){
-            cerr << "overriding db_file: found --db = " << argv[2] <<  ".. \n";
-            sqlite_db = argv[2];
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--db") {
+            cerr << "overriding db_file: found --db = " << argv[i + 1] << ".. \n";
+            sqlite_db = argv[i + 1];
         }
     }
 
@@ -47,13 +61,37 @@ int main(int argc, char **argv) {
     // Instantiations
     Omnigraph *first_query = new Omnigraph();
     SQLiteManager *SQL = new SQLiteManager(sqlite_db);
-    SQL->create_reads_table(2);
-    kmerDecoder *READ_1_KMERS = new Kmers(PE_1_reads_file, batchSize, kSize);
-    kmerDecoder *READ_2_KMERS = new Kmers(PE_2_reads_file, batchSize, kSize);
+    SQL->create_reads_table(2, packed_seqs, persist_hashes);
+    if (SQL->persist_hashes) {
+        // Appending hashes of another function would make them useless to query_2.
+        string hashes_signature = kmerHasher::signature(kSize, hashing_mode);
+        string table_signature = SQL->get_meta("kmer_hashes");
+        if (!table_signature.empty() && table_signature != hashes_signature) {
+            cerr << "`reads` table holds k-mer hashes of (" << table_signature << "), not (" << hashes_signature
+                 << ")." << endl;
+            return 1;
+        }
+        SQL->set_meta("kmer_hashes", hashes_signature);
+    }
+    SQL->begin_bulk_load(2);
+    auto *READ_1_KMERS = new readsDecoder(PE_1_reads_file, batchSize, kSize, hashing_mode, readahead_mb);
+    auto *READ_2_KMERS = new readsDecoder(PE_2_reads_file, batchSize, kSize, hashing_mode, readahead_mb);
+    READ_1_KMERS->set_min_quality(min_quality);
+    READ_2_KMERS->set_min_quality(min_quality);
+
+    // Raw hashes of the k-mers of the stored (possibly trimmed) read, which is a view of read.seq.
+    auto stored_hashes = [&SQL, kSize](const decoded_read &read, string_view stored) -> string_view {
+        if (!SQL->persist_hashes || read.hashes.empty() || stored.size() < (size_t) kSize) return {};
+        size_t first_kmer = stored.data() - read.seq.data();
+        size_t kmers = stored.size() - kSize + 1;
+        return {(const char *) (read.hashes.data() + first_kmer), kmers * sizeof(uint64_t)};
+    };
 
     // Initializations
     int no_chunks = no_of_sequences / batchSize;
     int Reads_chunks_counter = 0;
+    int processed_reads = 0;
+    auto *tuner = new batchTuner(batchSize, target_chunk_ms, max_chunk_mb, sqlite_db + "_batchSizes.tsv");
 
 
     // kProcessor Index Loading
@@ -64,55 +102,83 @@ int main(int argc, char **argv) {
     std::cerr << "kProcessor index loaded successfully ..." << std::endl;
 
 
+    runMetrics metrics(reader.Get("metrics", "file", ""), reader.GetReal("metrics", "interval_sec", 0));
+    metrics.begin_stage("query_1");
+
     while (!READ_1_KMERS->end() && !READ_2_KMERS->end()) {
 
         cerr << "processing chunk: (" << ++Reads_chunks_counter << ") / (" << no_chunks << ") ... ";
-        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+        scopedTimer chunk_timer(&metrics, "chunk_ms");
 
+        double io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms();
+        double parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms;
         READ_1_KMERS->next_chunk();
         READ_2_KMERS->next_chunk();
+        io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms() - io_wait;
+        parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms - parse_time;
 
 
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1 = READ_1_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2 = READ_2_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1_end = READ_1_KMERS->getKmers()->end();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2_end = READ_2_KMERS->getKmers()->end();
+        auto seq1 = READ_1_KMERS->getReads()->begin();
+        auto seq2 = READ_2_KMERS->getReads()->begin();
+        auto seq1_end = READ_1_KMERS->getReads()->end();
+        auto seq2_end = READ_2_KMERS->getReads()->end();
 
         while (seq1 != seq1_end && seq2 != seq2_end) {
-            tuple<string, bool, int, uint64_t> read_1_result = first_query->classifyRead(kf, seq1->second, 1);
-            tuple<string, bool, int, uint64_t> read_2_result = first_query->classifyRead(kf, seq2->second, 2);
+            auto read_1_result = first_query->classifyRead(kf, *seq1, 1);
+            auto read_2_result = first_query->classifyRead(kf, *seq2, 2);
 
-            string read_1_constructedRead = get<0>(read_1_result);
+            string_view read_1_constructedRead = get<0>(read_1_result);
             bool read_1_mapped_flag = get<1>(read_1_result);
-            int read_1_collectiveComponent = get<3>(read_1_result);
+            uint32_t read_1_collectiveComponent = get<3>(read_1_result);
 
-            string read_2_constructedRead = get<0>(read_2_result);
+            string_view read_2_constructedRead = get<0>(read_2_result);
             bool read_2_mapped_flag = get<1>(read_2_result);
-            int read_2_collectiveComponent = get<3>(read_2_result);
+            uint32_t read_2_collectiveComponent = get<3>(read_2_result);
 
-            SQL->insert_PE(read_1_constructedRead, read_2_constructedRead, read_1_collectiveComponent,
-                           read_2_collectiveComponent);
+            SQL->bulk_insert({read_1_constructedRead, read_2_constructedRead, read_1_collectiveComponent,
+                              read_2_collectiveComponent, 0, 0, stored_hashes(*seq1, read_1_constructedRead),
+                              stored_hashes(*seq2, read_2_constructedRead)});
 
             seq1++;
             seq2++;
         }
 
 
-        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-        auto milli = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        long hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        long min = milli / 60000;
-        milli = milli - 60000 * min;
-        long sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cerr << "Done in: ";
-        cerr << min << ":" << sec << ":" << milli << endl;
+        double chunk_ms = chunk_timer.stop();
+        double rows_per_sec = SQL->rows_per_sec();
+        cerr << "Done in: " << runMetrics::format_ms(chunk_ms);
+        cerr << " (io wait: " << (long) io_wait << "ms, parse: " << (long) parse_time << "ms)";
+        cerr << " | " << (long) rows_per_sec << " rows/s";
+
+        int chunk_reads = READ_1_KMERS->getReads()->size();
+        processed_reads += chunk_reads;
+        metrics.add("chunks");
+        metrics.add("pairs", chunk_reads);
+        metrics.observe("io_wait_ms", io_wait);
+        metrics.observe("parse_ms", parse_time);
+        metrics.set("rows_per_sec", rows_per_sec);
+        metrics.set("bytes_read", (double) (READ_1_KMERS->bytes_read() + READ_2_KMERS->bytes_read()));
+        if (tuner->enabled()) {
+            size_t chunk_bytes = READ_1_KMERS->chunk_bytes + READ_2_KMERS->chunk_bytes;
+            batchSize = tuner->update(chunk_reads, chunk_ms, chunk_bytes);
+            READ_1_KMERS->set_batch_size(batchSize);
+            READ_2_KMERS->set_batch_size(batchSize);
+            no_chunks = Reads_chunks_counter + max(0, no_of_sequences - processed_reads) / batchSize;
+            cerr << " | next batch: " << batchSize;
+        }
+        cerr << endl;
 
     }
 
 
 
+    {
+        scopedTimer timer(&metrics, "end_bulk_load_ms");
+        SQL->end_bulk_load();
+    }
+    metrics.add("lookups", first_query->lookups);
+    metrics.add("lookup_hits", first_query->lookup_hits);
+
     // Printing a summary report
 
     for (int p = 1; p <= 2; p++) {
@@ -128,14 +194,22 @@ int main(int argc, char **argv) {
             int count = first_query->scenarios_count[p][scenario];
             string description = first_query->scenario_descriptions[scenario];
             cout << "Scenario (" << scenario << ") : Count: " << count << " | " << description << endl;
+            metrics.add("R" + to_string(p) + ".scenario_" + to_string(scenario), count);
         }
         cout << "---------------------------------" << endl;
     }
 
+    if (min_quality > 0) {
+        cout << "Quality-masked kmers (phred < " << min_quality << "): R1: " << READ_1_KMERS->masked_kmers
+             << " | R2: " << READ_2_KMERS->masked_kmers << endl;
+    }
+
+    metrics.close();
     SQL->close();
     delete kf;
     delete READ_1_KMERS;
     delete READ_2_KMERS;
+    tuner->close();
 
     return 0;
 }
@@ -0,0 +1,71 @@
+#ifndef OMNIGRAPH_ASYNCDBWRITER_HPP
+#define OMNIGRAPH_ASYNCDBWRITER_HPP
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "readsStore.hpp"
+#include "chunkArena.hpp"
+
+using namespace std;
+
+// Rows of one chunk with the arena their sequences are copied into.
+struct rowsBuffer {
+    chunkArena arena;
+    std::pmr::vector<PE_row> rows{&arena};
+    // Resume point after these rows, handed to the store once they're inserted.
+    run_checkpoint checkpoint;
+    bool has_checkpoint = false;
+
+    void push_back(string_view seq1, string_view seq2, uint32_t comp1, uint32_t comp2,
+                   uint64_t offset1 = 0, uint64_t offset2 = 0) {
+        this->rows.push_back({this->arena.copy(seq1), this->arena.copy(seq2), comp1, comp2, offset1, offset2});
+    }
+
+    void reset() {
+        std::pmr::vector<PE_row>(&this->arena).swap(this->rows);
+        this->arena.reset();
+        this->has_checkpoint = false;
+    }
+};
+
+/*
+ * Dedicated store writer (SQLite, columnar or partition buckets). The classifier fills a rowsBuffer, submits it and moves on to the
+ * next chunk while this thread bulk-inserts it. Buffers are recycled through a bounded pool,
+ * so the classifier only blocks when every buffer is still waiting to be written.
+ * The writer thread is the only user of the store between begin and finish().
+ */
+class asyncDBWriter {
+
+    readsStore *store;
+    vector<rowsBuffer *> buffers;
+    deque<rowsBuffer *> free_buffers, pending;
+    bool finishing = false;
+
+    thread writer;
+    mutex mtx;
+    condition_variable cv_pending, cv_free;
+
+    void write_loop();
+
+public:
+    atomic<uint64_t> rows_written{0};
+    double blocked_ms = 0;
+
+    asyncDBWriter(readsStore *store, int queue_depth = 2);
+
+    // Next empty buffer, blocks while all buffers are queued or being written.
+    rowsBuffer *acquire();
+
+    void submit(rowsBuffer *buffer);
+
+    // Drains the queue and joins the writer, the store is handed back to the caller.
+    void finish();
+
+    ~asyncDBWriter();
+};
+
+#endif //OMNIGRAPH_ASYNCDBWRITER_HPP
@@ -0,0 +1,68 @@
+#ifndef OMNIGRAPH_ASYNCREADER_HPP
+#define OMNIGRAPH_ASYNCREADER_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <zlib.h>
+
+using namespace std;
+
+/*
+ * Background readahead over a reads file.
+ * A producer thread keeps up to `n_blocks` aligned buffers filled ahead of the consumer,
+ * so the chunk loop only waits on I/O when the prefetch window is exhausted.
+ * gzip input is inflated transparently by zlib, plain files are passed through.
+ */
+class asyncReader {
+
+    struct block {
+        char *data = nullptr;
+        size_t length = 0;
+        uint64_t offset = 0;
+    };
+
+    vector<block> blocks;
+    deque<int> filled, free_blocks;
+    int current_block = -1;
+    size_t block_size;
+    bool eof = false;
+    bool stopped = false;
+    string error_message;
+
+    int fd = -1;
+    gzFile gz = nullptr;
+    uint64_t read_offset = 0;
+
+    thread producer;
+    mutex mtx;
+    condition_variable cv_filled, cv_free;
+
+    void produce();
+
+public:
+    string filename;
+    double io_wait_ms = 0;
+    uint64_t bytes_read = 0;
+    // Uncompressed offset of the block last handed out by next_block.
+    uint64_t block_offset = 0;
+    // gzip input, offsets then refer to the inflated stream and can't be used to seek in the file.
+    bool compressed = false;
+
+    // Reading starts at `start_offset` of the (uncompressed) input, gzip input is inflated up to it.
+    explicit asyncReader(const string &filename, size_t readahead_mb = 64, size_t block_mb = 8,
+                         uint64_t start_offset = 0);
+
+    // Hands out the next filled block, previously returned block is recycled.
+    // Returns false at end of file.
+    bool next_block(const char *&data, size_t &length);
+
+    ~asyncReader();
+};
+
+
+#endif //OMNIGRAPH_ASYNCREADER_HPP
@@ -0,0 +1,40 @@
+#ifndef OMNIGRAPH_BATCHTUNER_HPP
+#define OMNIGRAPH_BATCHTUNER_HPP
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Picks the next chunk size from the measured time and memory of the last chunk.
+ * The size moves toward `target_ms` per chunk, at most doubling or halving per step,
+ * and never beyond what fits in `max_chunk_mb`. Every decision is logged as TSV so a
+ * run can be replayed with fixed sizes.
+ */
+class batchTuner {
+
+    int batch_size;
+    int min_batch, max_batch;
+    double target_ms;
+    size_t memory_ceiling;
+    double ms_per_read = 0;
+    int chunk_no = 0;
+    ofstream log;
+
+public:
+    batchTuner(int initial_batch, double target_ms, size_t max_chunk_mb, const string &log_file,
+               int min_batch = 1000, int max_batch = 2000000);
+
+    bool enabled() { return this->target_ms > 0; }
+
+    int size() { return this->batch_size; }
+
+    // Feed back the last chunk, returns the size of the next one.
+    int update(int chunk_reads, double chunk_ms, size_t chunk_bytes);
+
+    void close() { this->log.close(); }
+};
+
+#endif //OMNIGRAPH_BATCHTUNER_HPP
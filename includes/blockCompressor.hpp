@@ -0,0 +1,59 @@
+#ifndef OMNIGRAPH_BLOCKCOMPRESSOR_HPP
+#define OMNIGRAPH_BLOCKCOMPRESSOR_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+
+// One gzip member and the worker time spent deflating it.
+struct compressed_block {
+    string member;
+    uint64_t compress_us = 0;
+};
+
+/*
+ * Worker pool deflating independent blocks into complete gzip members.
+ * Concatenated members are a valid .gz stream (gzip -d, zcat and zlib readers inflate them in sequence),
+ * so the blocks of one file can be compressed in parallel and appended in submission order.
+ */
+class blockCompressor {
+
+    int level;
+    vector<thread> workers;
+    deque<packaged_task<compressed_block()>> tasks;
+    bool stopped = false;
+    mutex mtx;
+    condition_variable cv_tasks;
+
+    void work_loop();
+
+    compressed_block compress(const string &block);
+
+public:
+    atomic<uint64_t> raw_bytes{0}, compressed_bytes{0};
+    // Summed over the workers.
+    atomic<uint64_t> compress_us{0};
+
+    blockCompressor(int threads, int level = 6);
+
+    future<compressed_block> submit(string &&block);
+
+    int threads() { return this->workers.size(); }
+
+    // Per-thread deflate throughput.
+    double mb_per_sec();
+
+    // Totals, ratio and throughput to stderr, `writer_wait_ms` is the time writers blocked on the workers.
+    void print_summary(double writer_wait_ms);
+
+    ~blockCompressor();
+};
+
+#endif //OMNIGRAPH_BLOCKCOMPRESSOR_HPP
@@ -0,0 +1,122 @@
+#ifndef OMNIGRAPH_BUCKETWRITERPOOL_HPP
+#define OMNIGRAPH_BUCKETWRITERPOOL_HPP
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <deque>
+#include <future>
+#include <ostream>
+#include <functional>
+#include <chrono>
+#include <parallel_hashmap/phmap.h>
+#include "readsStore.hpp"
+#include "blockCompressor.hpp"
+
+using namespace std;
+
+/*
+ * Buffered append-only writers for an unbounded number of bucket files (one per component) with at most
+ * `max_open_files` descriptors open at once. Buckets are addressed by key and their path is built on first use;
+ * the least recently written bucket is flushed and closed when the pool is full, and re-opened in append mode
+ * if it is written again. Only open buckets keep a buffer, so memory is bounded by max_open_files * buffer_bytes.
+ *
+ * With a blockCompressor, every full buffer is handed to the workers as one gzip member and the members are
+ * appended to the bucket in order as they complete; the writing thread only waits once more than
+ * 4 blocks per worker are in flight. Bucket paths then get a ".gz" suffix.
+ */
+class bucketWriterPool {
+
+    struct bucket {
+        int fd = -1;
+        bool created = false;
+        string buffer;
+        list<uint64_t>::iterator lru;
+        deque<future<compressed_block>> pending;
+        uint64_t submitted = 0, written_blocks = 0;
+        uint64_t raw_bytes = 0, stored_bytes = 0;
+        uint64_t compress_us = 0;
+    };
+
+    function<string(uint64_t)> bucket_path;
+    phmap::flat_hash_map<uint64_t, bucket> buckets;
+    list<uint64_t> lru; // most recently written first
+    size_t max_open_files;
+    size_t buffer_bytes;
+
+    blockCompressor *compressor = nullptr;
+    deque<pair<uint64_t, uint64_t>> submission_order; // (bucket, block number)
+    size_t in_flight = 0;
+
+    string path_of(uint64_t key);
+
+    void open_bucket(uint64_t key, bucket &b);
+
+    void write_out(bucket &b, const char *data, size_t length);
+
+    void flush_bucket(uint64_t key, bucket &b);
+
+    // Appends the completed blocks at the head of the bucket's queue, or all of them when `wait` is set.
+    void drain(bucket &b, bool wait);
+
+    void wait_oldest();
+
+    void close_bucket(uint64_t key, bucket &b);
+
+public:
+    uint64_t opens = 0, evictions = 0, bytes_written = 0;
+    double compress_wait_ms = 0;
+
+    bucketWriterPool(function<string(uint64_t)> bucket_path, size_t max_open_files = 512,
+                     size_t buffer_bytes = 64 * 1024);
+
+    // Gzip the buckets on `compressor`'s workers, must be set before the first write.
+    void set_compressor(blockCompressor *compressor);
+
+    void write(uint64_t key, string_view data);
+
+    size_t buckets_count() { return this->buckets.size(); }
+
+    // Flushes and closes every open bucket.
+    void close_all();
+
+    // compression.tsv: path, raw bytes, stored bytes, compression ratio, deflate time of the bucket's blocks
+    // and the resulting throughput in MB/s.
+    static void report_header(ostream &out);
+    void report(ostream &out);
+
+    ~bucketWriterPool();
+};
+
+/*
+ * Reads store writing every classified pair straight into per-original-component FASTA buckets under `dir`.
+ * Both mates (headers >ID.1 / >ID.2) go to <comp1>.fa, or to <comp2>.fa when R1 is unmapped, so a pair
+ * spanning two components is written once; only pairs with both mates unmapped go to 0.fa.
+ * IDs follow the input order starting at 1, as the `reads` table does. With a compressor the buckets are
+ * <comp>.fa.gz and a per-partition compression.tsv is written at the end.
+ */
+class partitionStore : public readsStore {
+
+    bucketWriterPool *pool;
+    blockCompressor *compressor;
+    string dir;
+    string record;
+    uint64_t next_row_id = 1;
+    uint64_t rows_written = 0;
+    chrono::high_resolution_clock::time_point load_start;
+
+    void write_pair(uint64_t ID, const PE_row &row);
+
+public:
+    partitionStore(const string &dir, size_t max_open_files, blockCompressor *compressor = nullptr);
+
+    void bulk_insert(const std::pmr::vector<PE_row> &rows) override;
+
+    void end_bulk_load() override;
+
+    double rows_per_sec() override;
+
+    ~partitionStore() override;
+};
+
+#endif //OMNIGRAPH_BUCKETWRITERPOOL_HPP
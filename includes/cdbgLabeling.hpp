@@ -0,0 +1,22 @@
+#ifndef OMNIGRAPH_CDBGLABELING_HPP
+#define OMNIGRAPH_CDBGLABELING_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <cstdint>
+#include <parallel_hashmap/phmap.h>
+#include "runMetrics.hpp"
+
+using namespace std;
+
+// unitig ID -> original component of a `<unitig>\t<component>` names TSV.
+void parse_namesFile(const string &names_fileName, flat_hash_map<uint32_t, uint32_t> &groupNameMap);
+
+/*
+ * Labels every k-mer of the cDBG unitigs with the original component of its unitig.
+ * The index is returned in memory, saving it is left to the caller. Recorded under the "label" stage of `metrics`.
+ */
+kDataFrame *label_cDBG(const string &fasta_file, const string &names_tsv, int kSize, int hashing_mode,
+                       runMetrics *metrics = nullptr, int chunkSize = 100);
+
+#endif //OMNIGRAPH_CDBGLABELING_HPP
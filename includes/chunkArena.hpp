@@ -0,0 +1,82 @@
+#ifndef OMNIGRAPH_CHUNKARENA_HPP
+#define OMNIGRAPH_CHUNKARENA_HPP
+
+#include <memory_resource>
+#include <memory>
+#include <vector>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * Bump allocator for everything that lives for one chunk.
+ * Deallocation is a no-op, reset() rewinds to the first block and keeps all blocks,
+ * so once the first chunks have sized it the chunk loop stops touching the heap.
+ * Containers carved from the arena must be gone before reset().
+ */
+class chunkArena : public std::pmr::memory_resource {
+
+    vector<unique_ptr<char[]>> blocks;
+    vector<size_t> block_sizes;
+    size_t block_size;
+    size_t current = 0;
+    size_t offset = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        while (current < blocks.size()) {
+            auto base = (uintptr_t) blocks[current].get();
+            uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t) (alignment - 1);
+            if (aligned + bytes <= base + block_sizes[current]) {
+                offset = aligned + bytes - base;
+                return (void *) aligned;
+            }
+            current++;
+            offset = 0;
+        }
+
+        size_t size = max(block_size, bytes + alignment);
+        blocks.emplace_back(new char[size]);
+        block_sizes.push_back(size);
+        return do_allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit chunkArena(size_t block_mb = 64) {
+        this->block_size = block_mb << 20;
+    }
+
+    string_view copy(string_view str) {
+        if (str.empty()) return {};
+        auto *dest = (char *) this->allocate(str.size(), 1);
+        memcpy(dest, str.data(), str.size());
+        return string_view(dest, str.size());
+    }
+
+    void reset() {
+        this->current = 0;
+        this->offset = 0;
+    }
+
+    size_t used() {
+        size_t total = this->offset;
+        for (size_t i = 0; i < this->current && i < this->block_sizes.size(); i++) total += this->block_sizes[i];
+        return total;
+    }
+
+    size_t capacity() {
+        size_t total = 0;
+        for (auto &size : this->block_sizes) total += size;
+        return total;
+    }
+};
+
+#endif //OMNIGRAPH_CHUNKARENA_HPP
@@ -0,0 +1,50 @@
+#ifndef OMNIGRAPH_COLOREDCLASSIFIER_HPP
+#define OMNIGRAPH_COLOREDCLASSIFIER_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <parallel_hashmap/phmap.h>
+#include "seqEncoder.hpp"
+
+using namespace std;
+
+struct colored_result {
+    uint32_t kmers = 0, matched_kmers = 0;
+    // Source with the most matched k-mers, UINT32_MAX when nothing matched.
+    uint32_t best_source = UINT32_MAX, best_votes = 0;
+    // Sources shared by every matched k-mer, sorted.
+    vector<uint32_t> intersection;
+};
+
+/*
+ * Per-read classification over a colored_kDataFrame, the native counterpart of batchQuery_trial/batch_query.py:
+ * every k-mer votes for the sources of its color (majority vote) and the sources common to all the matched
+ * k-mers are intersected. Consecutive k-mers sharing a color are handled once, weighted by the run length.
+ *
+ * The colors' sources are kept as sorted arrays in a per-classifier cache, only cache misses go to the index,
+ * serialized by a lock shared by all the classifiers of an index. Use one classifier per thread.
+ */
+class coloredClassifier {
+
+    colored_kDataFrame *ckf;
+    kDataFrame *kf;
+    mutex *index_mutex;
+
+    flat_hash_map<uint64_t, vector<uint32_t>> color_sources;
+    vector<uint32_t> votes, voted_sources;
+    vector<uint32_t> intersection_buffer;
+
+    const vector<uint32_t> &sources_of(uint64_t color);
+
+public:
+    uint64_t cache_misses = 0;
+
+    coloredClassifier(colored_kDataFrame *ckf, mutex *index_mutex, size_t n_sources = 0);
+
+    void classify(const decoded_read &read, colored_result &result);
+};
+
+#endif //OMNIGRAPH_COLOREDCLASSIFIER_HPP
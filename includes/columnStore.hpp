@@ -0,0 +1,99 @@
+#ifndef OMNIGRAPH_COLUMNSTORE_HPP
+#define OMNIGRAPH_COLUMNSTORE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <chrono>
+#include <parallel_hashmap/phmap.h>
+#include "readsStore.hpp"
+
+using namespace std;
+
+/*
+ * Append-only columnar store for classified read pairs, an alternative to the SQLite `reads` table.
+ *
+ * <dir>/segments.bin holds one segment per written chunk:
+ *   segment_header
+ *   uint32 components[n_components]   distinct non-zero components of the segment, sorted
+ *   uint32 comp1[n_rows], comp2[n_rows]
+ *   uint32 seq_sizes[2 * n_rows]      packed size of seq1 and seq2 of every row
+ *   uint8  seqs[seq_bytes]            seqEncoder 2-bit packed sequences
+ *
+ * <dir>/index.bin, written by end_bulk_load(), lists the segment offsets and a
+ * component -> segments index, so pulling the reads of a set of components only reads
+ * the segments that contain them, in file order.
+ */
+
+#define COLUMNSTORE_SEGMENT_MAGIC 0x4745534fu // "OSEG"
+
+struct segment_header {
+    uint32_t magic;
+    uint32_t n_rows;
+    uint64_t first_row_id;
+    uint32_t min_comp, max_comp;
+    uint32_t n_components;
+    uint32_t reserved;
+    uint64_t seq_bytes;
+};
+
+struct column_row {
+    uint64_t ID;
+    string seq1, seq2;
+    uint32_t comp1, comp2;
+};
+
+class columnStore : public readsStore {
+
+    string dir;
+    ofstream segments;
+    uint64_t offset = 0;
+    uint64_t next_row_id = 1;
+
+    vector<uint64_t> segment_offsets;
+    vector<uint32_t> segment_rows;
+    phmap::flat_hash_map<uint32_t, vector<uint32_t>> component_segments;
+
+    // per-segment scratch, reused between chunks
+    vector<uint32_t> comp1, comp2, seq_sizes, components;
+    vector<uint8_t> seqs;
+
+    chrono::high_resolution_clock::time_point load_start;
+    uint64_t rows_written = 0;
+
+public:
+    explicit columnStore(const string &dir);
+
+    void bulk_insert(const std::pmr::vector<PE_row> &rows) override;
+
+    void end_bulk_load() override;
+
+    double rows_per_sec() override;
+};
+
+class columnStoreReader {
+
+    string dir;
+    int fd = -1;
+    vector<uint64_t> segment_offsets;
+    vector<uint32_t> segment_rows;
+    phmap::flat_hash_map<uint32_t, vector<uint32_t>> component_segments;
+
+public:
+    explicit columnStoreReader(const string &dir);
+
+    size_t segments_count() { return this->segment_offsets.size(); }
+
+    // Sorted ids of the segments holding at least one read of `components`.
+    vector<uint32_t> segments_for(const vector<uint32_t> &components);
+
+    // Streams every row of the given segments in file order.
+    void scan(const vector<uint32_t> &segment_ids, const function<void(column_row &)> &callback);
+
+    void scan_all(const function<void(column_row &)> &callback);
+
+    ~columnStoreReader();
+};
+
+#endif //OMNIGRAPH_COLUMNSTORE_HPP
@@ -0,0 +1,44 @@
+#ifndef OMNIGRAPH_COMPONENTRUNS_HPP
+#define OMNIGRAPH_COMPONENTRUNS_HPP
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <parallel_hashmap/phmap.h>
+#include "sqliteManager.hpp"
+#include "seqEncoder.hpp"
+
+using namespace std;
+
+/*
+ * Per collective component run files of the `reads` table, so query_2 reads the table in one sequential scan
+ * instead of two SELECTs per component (seq2_collective_component isn't indexed, every R2 SELECT is a full scan).
+ * Every mate goes to <dir>/<comp>.<R>.run as [uint32 ID][uint32 length][uint32 hashes][sequence][uint64 hashes],
+ * in table order. Hashes are only spilled when query_1 persisted them, a mate without hashes has 0.
+ */
+class componentRuns {
+
+    string dir;
+
+public:
+    // R1 reads per collective component, filled by spill().
+    flat_hash_map<int, uint64_t> component_reads;
+    uint64_t scanned_pairs = 0, spilled_bytes = 0;
+    double spill_sec = 0;
+
+    explicit componentRuns(const string &dir);
+
+    string path(int comp, int R_ID) const;
+
+    // Scans the reads table once, keeping only the mates of the `wanted` components.
+    void spill(SQLiteManager *SQL, const flat_hash_set<int> &wanted, size_t max_open_files, bool with_hashes = false);
+
+    // Streams a run in table order into `read` and deletes it, false when the component has no reads for this mate.
+    // f(ID, hashed): `hashed` is set when read.hashes holds the persisted hashes of read.seq.
+    bool consume(int comp, int R_ID, decoded_read &read, const function<void(int ID, bool hashed)> &f) const;
+
+    // Removes the runs directory, once every run is consumed.
+    void remove_dir() const;
+};
+
+#endif //OMNIGRAPH_COMPONENTRUNS_HPP
@@ -0,0 +1,63 @@
+#ifndef OMNIGRAPH_COMPONENTSCHEDULER_HPP
+#define OMNIGRAPH_COMPONENTSCHEDULER_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+using namespace std;
+
+// One collective component of query_2: its index and the size estimates used for ordering and budgeting.
+struct component_task {
+    int ID;
+    string index_prefix;
+    uint64_t index_bytes = 0;
+    uint64_t reads = 0;
+};
+
+/*
+ * Runs the collective components on `workers` threads under a RAM budget.
+ * A loader thread loads the indexes ahead in the given order while the workers classify the loaded ones;
+ * an index is only loaded once its on-disk size fits in what's left of the budget (or nothing else is
+ * resident, so an index larger than the budget still runs, alone). The worker deletes the kDataFrame and
+ * frees its share of the budget when done.
+ */
+class componentScheduler {
+
+    vector<component_task> tasks;
+    int workers;
+    uint64_t budget_bytes;
+
+    uint64_t resident_bytes = 0;
+    size_t next_task = 0;
+    bool loading_done = false;
+    deque<pair<component_task *, kDataFrame *>> loaded;
+    mutex mtx;
+    condition_variable cv_budget, cv_loaded;
+
+    void load_loop(const function<kDataFrame *(component_task &)> &load);
+
+    void work_loop(int worker_id, const function<void(component_task &, kDataFrame *, int)> &process);
+
+public:
+    double budget_wait_ms = 0, load_ms = 0;
+    vector<double> idle_ms;
+
+    // budget_mb = 0: no budget, at most `workers` indexes are loaded ahead.
+    componentScheduler(vector<component_task> tasks, int workers, uint64_t budget_mb);
+
+    // Sums the sizes of the files sharing each task's index prefix.
+    static uint64_t index_size(const string &index_prefix);
+
+    // process(task, kf, worker_id) runs on the worker threads, the index is deleted afterwards.
+    void run(const function<kDataFrame *(component_task &)> &load,
+             const function<void(component_task &, kDataFrame *, int)> &process);
+};
+
+#endif //OMNIGRAPH_COMPONENTSCHEDULER_HPP
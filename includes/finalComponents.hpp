@@ -0,0 +1,87 @@
+#ifndef OMNIGRAPH_FINALCOMPONENTS_HPP
+#define OMNIGRAPH_FINALCOMPONENTS_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Original -> final components map: the original components linked by read pairs (pairs count >= cutoff)
+ * are merged with an array union-find (path compression + union by rank), then renumbered densely from 1,
+ * connected groups first (ordered by their smallest original component) followed by every original
+ * component left isolated, in increasing order. Original component IDs are already dense (1..n),
+ * so they index the union-find arrays directly.
+ *
+ * The groups are the ones dump_finalComps.py builds, not their IDs: the script numbers the groups by first
+ * appearance in the pairs count edge list and the isolated components in set order.
+ *
+ * Binary form (_finalComponents.bin):
+ *   final_components_header
+ *   uint32 final_of[n_original + 1]
+ *   per final component 1..n_final: uint32 original components, uint64 reads
+ */
+
+#define FINAL_COMPONENTS_MAGIC 0x31504d4f434e4946ull // "FINCOMP1"
+
+struct final_components_header {
+    uint64_t magic;
+    uint32_t n_original, n_final, n_connected, cutoff;
+};
+class finalComponents {
+
+    vector<uint32_t> parent;
+    vector<uint8_t> rank;
+    vector<bool> linked;
+    vector<uint64_t> original_reads;
+
+    uint32_t find(uint32_t x);
+
+    void grow(uint32_t comp);
+
+public:
+    // Indexed by original component, 0 for unknown ones.
+    vector<uint32_t> final_of;
+    // Indexed by final component.
+    vector<uint32_t> final_originals;
+    vector<uint64_t> final_reads;
+    uint32_t n_final = 0, n_connected = 0;
+    uint32_t cutoff;
+    uint64_t edges_used = 0, edges_filtered = 0;
+
+    explicit finalComponents(uint32_t n_original = 0, uint32_t cutoff = 1);
+
+    void add_edge(uint32_t comp1, uint32_t comp2);
+
+    // Edge if count >= cutoff.
+    void add_pairs_count(uint32_t comp1, uint32_t comp2, uint32_t count);
+
+    // Adds the edges of a `comp1 comp2 count` TSV (with header).
+    void load_pairs_count(const string &tsv_file);
+
+    // Reads classified to an original component, summed into the final component sizes.
+    void add_reads(uint32_t comp, uint64_t reads);
+
+    void construct();
+
+    uint32_t get(uint32_t original) {
+        return original < this->final_of.size() ? this->final_of[original] : 0;
+    }
+
+    // col1: final component, col2: comma-separated original components
+    void tsv_export(const string &file_name);
+
+    // col1: final component, col2: number of original components, col3: reads
+    void sizes_tsv_export(const string &file_name);
+
+    void binary_export(const string &file_name);
+
+    // Loads a map written by binary_export instead of constructing one.
+    void binary_import(const string &file_name);
+
+    // Highest component ID in the `compID,unitig,...` CSV of the original components.
+    static uint32_t count_original_components(const string &csv_file);
+};
+
+#endif //OMNIGRAPH_FINALCOMPONENTS_HPP
@@ -0,0 +1,32 @@
+#ifndef OMNIGRAPH_FINALCOMPSDUMPER_HPP
+#define OMNIGRAPH_FINALCOMPSDUMPER_HPP
+
+#include <string>
+#include <cstdint>
+#include "finalComponents.hpp"
+#include "runMetrics.hpp"
+
+using namespace std;
+
+struct dump_options {
+    string out_dir;
+    int threads = 1;
+    // shared by all threads
+    int max_open_files = 512;
+    int gzip_level = 0;
+    int gzip_threads = 4;
+    // Recorded under the "dump" stage, kept local when null.
+    runMetrics *metrics = nullptr;
+};
+
+/*
+ * Dumps the final components of a single partitioning run to <out_dir>/<finalComp>.fa. The reads are read in
+ * one sequential scan of the `reads` table, the columnar store or the manifest at `reads_path`, and every batch
+ * is written in parallel: thread t owns the final components with finalComp % threads == t.
+ *
+ * A pair belongs to a final component when both mates map to it, or one maps to it and the other is unmapped.
+ * Returns the number of dumped pairs, throws runtime_error when out_dir can't be created.
+ */
+uint64_t dump_final_components(const string &reads_path, finalComponents &components, const dump_options &options);
+
+#endif //OMNIGRAPH_FINALCOMPSDUMPER_HPP
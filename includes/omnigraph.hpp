@@ -1,6 +1,7 @@
 #include <iostream>
 #include <kDataFrame.hpp>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <cstdint>
@@ -8,6 +9,7 @@
 #include <iostream>
 #include <tuple>
 #include "sqliteManager.hpp"
+#include "seqEncoder.hpp"
 
 
 class Omnigraph {
@@ -44,6 +46,9 @@ public:
                     }
             };
 
+    // Index lookups of the decoded-read classifiers, and how many of them found a component.
+    uint64_t lookups = 0, lookup_hits = 0;
+
     flat_hash_map<int, string> scenario_descriptions = {
             {1, "Mapped: from matching the first and last kmers only."},
             {2, "Unmapped: Both terminal kmers matched but on different components."},
@@ -60,7 +65,9 @@ public:
     }
 
     tuple<string, bool, int, uint32_t> classifyRead(kDataFrame *kf, std::vector<kmer_row> &kmers, int PE);
-    tuple<string, bool, int, uint32_t, double> classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers, int PE);
+    tuple<string_view, bool, int, uint32_t> classifyRead(kDataFrame *kf, decoded_read &read, int PE);
+    uint64_t lookup_color(kDataFrame *kf, uint64_t hash);
+    tuple<string, bool, int, uint32_t, double> classifyRead_withStats(kDataFrame *kf, decoded_read &read, int PE);
 
     static string kmers_to_seq(vector<kmer_row> &kmers);
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef OMNIGRAPH_PAIRSCOUNT_HPP
+#define OMNIGRAPH_PAIRSCOUNT_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <parallel_hashmap/phmap.h>
+
+using namespace std;
+
+/*
+ * Counts of read pairs linking two original components, keyed by both IDs packed into one uint64_t
+ * (smaller ID in the high half). The map is split into 2^shards_log2 shards selected by a hash of the key,
+ * each behind its own mutex, so classification threads update it concurrently. Shards hold disjoint keys,
+ * so reading the whole counter back needs no merge.
+ *
+ * Binary form (_pairsCount.bin): pairs_count_header, uint64 keys[n_pairs] (sorted), uint32 counts[n_pairs].
+ */
+
+#define PAIRS_COUNT_MAGIC 0x31544e4354524150ull // "PARTCNT1"
+
+struct pairs_count_header {
+    uint64_t magic;
+    uint64_t n_pairs;
+    uint32_t cutoff, reserved;
+};
+
+class pairs_count {
+
+    struct alignas(64) shard {
+        mutex mtx;
+        phmap::flat_hash_map<uint64_t, uint32_t> counts;
+    };
+
+    unique_ptr<shard[]> shards;
+    int shards_log2;
+
+    size_t shard_of(uint64_t key) const {
+        return (key * 0x9E3779B97F4A7C15ull) >> (64 - this->shards_log2);
+    }
+
+    // Keys with count >= cutoff, sorted.
+    vector<pair<uint64_t, uint32_t>> sorted_pairs(uint32_t cutoff);
+
+public:
+    string prefix;
+
+    explicit pairs_count(string prefix, int shards_log2 = 6);
+
+    static uint64_t pack(uint32_t comp1, uint32_t comp2) {
+        return ((uint64_t) min(comp1, comp2) << 32) | max(comp1, comp2);
+    }
+
+    static uint32_t first(uint64_t key) { return key >> 32; }
+
+    static uint32_t second(uint64_t key) { return (uint32_t) key; }
+
+    void insert_pair(uint32_t comp1, uint32_t comp2);
+
+    // Packed keys of one thread's chunk, every shard is locked once. The vector is reordered.
+    void insert_pairs(vector<uint64_t> &keys);
+
+    size_t size();
+
+    // f(comp1, comp2, count) for every pair with count >= cutoff, shard by shard.
+    template<typename F>
+    void for_each(F &&f, uint32_t cutoff = 1) {
+        for (size_t s = 0; s < ((size_t) 1 << this->shards_log2); s++) {
+            for (auto &entry : this->shards[s].counts) {
+                if (entry.second >= cutoff) f(first(entry.first), second(entry.first), entry.second);
+            }
+        }
+    }
+
+    void tsv_export(uint32_t cutoff = 1);
+
+    void binary_export(uint32_t cutoff = 1);
+
+    // Adds the counts of a binary dump.
+    void binary_import(const string &file_name);
+
+    // Whether `file_name` starts like a binary pairs count dump.
+    static bool is_binary(const string &file_name);
+};
+
+#endif //OMNIGRAPH_PAIRSCOUNT_HPP
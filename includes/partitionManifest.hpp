@@ -0,0 +1,79 @@
+#ifndef OMNIGRAPH_PARTITIONMANIFEST_HPP
+#define OMNIGRAPH_PARTITIONMANIFEST_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include "readsStore.hpp"
+
+using namespace std;
+
+/*
+ * Binary manifest of the classification: per pair, the offsets of its records in the original R1/R2
+ * files and the two original components. Sequences are never copied, dump_partitions reads them back
+ * from the inputs with pread.
+ *
+ * The dumped sequences are the raw input records: unlike the SQLite store, which keeps scenario 5 reads
+ * trimmed to their mapped part, they aren't trimmed, so the partitions of the two stores differ for such reads.
+ *
+ * Layout: manifest_header, R1 path, R2 path, manifest_record[n_pairs]. Pair IDs are the record index + 1.
+ */
+
+#define MANIFEST_MAGIC 0x314e414d494e4d4full // "OMNIMAN1"
+
+struct manifest_header {
+    uint64_t magic;
+    uint64_t n_pairs;
+    uint32_t R1_path_length, R2_path_length;
+};
+
+struct manifest_record {
+    uint64_t offset1, offset2;
+    uint32_t comp1, comp2;
+};
+
+class manifestStore : public readsStore {
+
+    ofstream out;
+    manifest_header header{};
+    vector<manifest_record> records;
+    chrono::high_resolution_clock::time_point load_start;
+
+public:
+    string path;
+
+    manifestStore(const string &path, const string &R1_file, const string &R2_file);
+
+    void bulk_insert(const std::pmr::vector<PE_row> &rows) override;
+
+    void end_bulk_load() override;
+
+    double rows_per_sec() override;
+};
+
+// Read-only view of a manifest, the records are mmapped.
+class manifestReader {
+
+    int fd = -1;
+    size_t mapped_size = 0;
+    void *mapped = nullptr;
+
+public:
+    string R1_file, R2_file;
+    const manifest_record *records = nullptr;
+    uint64_t n_pairs = 0;
+
+    explicit manifestReader(const string &path);
+
+    // First pread size, enough for a short-read record, larger records grow the window.
+    static const size_t initial_window = 1024;
+
+    // Sequence of the FASTA/FASTQ record starting at `offset` in `fd`, the window grows until the record fits.
+    static bool read_sequence(int fd, uint64_t offset, vector<char> &window, string &seq);
+
+    ~manifestReader();
+};
+
+#endif //OMNIGRAPH_PARTITIONMANIFEST_HPP
@@ -0,0 +1,54 @@
+#ifndef OMNIGRAPH_PRIMARYPARTITIONING_HPP
+#define OMNIGRAPH_PRIMARYPARTITIONING_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <cstdint>
+#include "finalComponents.hpp"
+#include "pairsCount.hpp"
+#include "runMetrics.hpp"
+
+using namespace std;
+
+struct partitioning_options {
+    string PE_1_reads_file, PE_2_reads_file, out_prefix;
+    int batchSize = 10000;
+    int no_of_sequences = 67954363;
+    int hashing_mode = 3;
+    int readahead_mb = 64;
+    int min_quality = 0;
+    double target_chunk_ms = 0;
+    int max_chunk_mb = 0;
+    bool packed_seqs = false;
+    // sqlite, columnar, partitions or manifest
+    string store_type = "sqlite";
+    int max_open_files = 512;
+    int gzip_level = 0;
+    int gzip_threads = 4;
+    uint32_t cutoff = 1;
+    int threads = 1;
+    string original_comps_file;
+    bool resume = false;
+    // On-disk artifacts besides the reads store: _pairsCount.tsv/.bin and the _finalComponents files.
+    bool export_pairs = true;
+    bool export_components = true;
+    // Recorded under the "partition" stage, kept local when null.
+    runMetrics *metrics = nullptr;
+};
+
+// Stays in memory for the next stage, the caller owns both.
+struct partitioning_result {
+    pairs_count *pairs = nullptr;
+    finalComponents *components = nullptr;
+    // Reads store written under out_prefix: _omni.db, _omni.cols, _omni.manifest or _partitions.
+    string reads_path;
+};
+
+/*
+ * Primary partitioning of a paired-end sample against the labeled cDBG `kf`: classifies every pair,
+ * writes the reads store, counts the pairs linking two original components and constructs the final
+ * components. Throws runtime_error on invalid options.
+ */
+void primary_partitioning(kDataFrame *kf, const partitioning_options &options, partitioning_result &result);
+
+#endif //OMNIGRAPH_PRIMARYPARTITIONING_HPP
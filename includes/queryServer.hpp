@@ -0,0 +1,78 @@
+#ifndef OMNIGRAPH_QUERYSERVER_HPP
+#define OMNIGRAPH_QUERYSERVER_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Line protocol of `omnigraph serve`, one request per line over a UNIX domain socket:
+ *   SEQ <name> <sequence>   ->  <name>\t<mapped>\t<scenario>\t<component>
+ *   FILE <path>             ->  one result line per read of a FASTA/FASTQ(.gz) file on the server's host,
+ *                               then OK <reads> <mapped>
+ *   PING                    ->  PONG
+ *   QUIT                       closes the connection
+ *   SHUTDOWN                   stops the server once the open connections are done
+ * Failures answer ERR <message>. Requests are answered in order, so clients may pipeline them.
+ */
+class queryServer {
+
+    kDataFrame *kf;
+    int kSize, hashing_mode;
+    string socket_path;
+    int listen_fd = -1;
+    atomic<bool> stopping{false};
+    // Connection threads by id, the finished ones are joined on the next accept.
+    mutex connections_mutex;
+    map<uint64_t, thread> connections;
+    vector<uint64_t> finished_connections;
+    uint64_t next_connection = 0;
+
+    void serve_connection(int fd, uint64_t id);
+
+    // Joins the connections that have returned, connections_mutex must be held.
+    void reap_connections();
+
+public:
+    atomic<uint64_t> served_reads{0}, served_requests{0};
+
+    queryServer(kDataFrame *kf, int kSize, int hashing_mode, const string &socket_path);
+
+    // Blocks until SHUTDOWN, returns false when the socket can't be bound.
+    bool run();
+
+    ~queryServer();
+};
+
+// Buffered line reader / writer over a socket descriptor.
+class lineChannel {
+
+    int fd;
+    string in, out;
+    size_t in_pos = 0;
+
+public:
+    explicit lineChannel(int fd) : fd(fd) {}
+
+    bool read_line(string &line);
+
+    // A complete request line is already buffered.
+    bool pending() { return this->in.find('\n', this->in_pos) != string::npos; }
+
+    // Buffers `data`, the buffer is sent once it grows past 64 KB or on flush().
+    bool write(const string &data);
+
+    bool flush();
+};
+
+// Connects to a queryServer socket, -1 on failure.
+int connect_query_socket(const string &socket_path);
+
+#endif //OMNIGRAPH_QUERYSERVER_HPP
@@ -0,0 +1,84 @@
+#ifndef OMNIGRAPH_READSDECODER_HPP
+#define OMNIGRAPH_READSDECODER_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <vector>
+#include <utility>
+#include "asyncReader.hpp"
+#include "seqEncoder.hpp"
+
+using namespace std;
+
+// The reads of the current chunk, slots beyond it are kept for reuse.
+struct readsChunk {
+    decoded_read *first = nullptr, *last = nullptr;
+
+    decoded_read *begin() { return first; }
+
+    decoded_read *end() { return last; }
+
+    size_t size() { return last - first; }
+};
+
+/*
+ * Chunked FASTA/FASTQ decoder on top of asyncReader.
+ * Replaces the kmerDecoder chunk loop: reads are kept in input order so R1 and R2 chunks
+ * pair up by position, and each read carries its sequence and k-mer hashes instead of
+ * one string per k-mer.
+ */
+class readsDecoder {
+
+    asyncReader *reader;
+    kmerHasher *hasher;
+    int batchSize;
+
+    const char *block = nullptr;
+    size_t block_length = 0, block_pos = 0;
+    string line, pending_header;
+    uint64_t line_offset = 0, pending_offset = 0;
+    bool has_pending_header = false;
+    bool finished = false;
+
+    vector<decoded_read> chunk;
+    readsChunk current;
+    size_t chunk_reads = 0;
+    int min_quality = 0;
+
+    bool next_line(string &line);
+    bool next_record(decoded_read &read);
+
+public:
+    double parse_ms = 0;
+    uint64_t masked_kmers = 0;
+    size_t chunk_bytes = 0;
+
+    // start_offset: byte offset of the record to start from, see next_record_offset().
+    readsDecoder(const string &filename, int batchSize, int kSize, int hashing_mode = -1, size_t readahead_mb = 64,
+                 uint64_t start_offset = 0);
+
+    // FASTQ only: k-mers covering a base with phred < min_quality are masked, 0 disables masking.
+    void set_min_quality(int min_quality);
+
+    // Takes effect from the next chunk.
+    void set_batch_size(int batchSize);
+
+    void next_chunk();
+
+    bool end();
+
+    readsChunk *getReads();
+
+    double io_wait_ms() { return this->reader->io_wait_ms; }
+    uint64_t bytes_read() { return this->reader->bytes_read; }
+
+    // Offset of the first record the next chunk will return, a resume point between chunks.
+    uint64_t next_record_offset();
+
+    // Record offsets only address the file itself when it's not gzipped.
+    bool compressed() { return this->reader->compressed; }
+
+    ~readsDecoder();
+};
+
+#endif //OMNIGRAPH_READSDECODER_HPP
@@ -0,0 +1,48 @@
+#ifndef OMNIGRAPH_READSSTORE_HPP
+#define OMNIGRAPH_READSSTORE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstdint>
+
+using namespace std;
+
+// One classified read pair waiting for insertion, sequences live in the chunk's arena.
+// Offsets locate the records in the R1/R2 inputs, they are only filled for the manifest store.
+// Hashes are the raw uint64 k-mer hashes of seq1/seq2, only persisted by the SQLite store when enabled.
+struct PE_row {
+    string_view seq1, seq2;
+    uint32_t comp1, comp2;
+    uint64_t offset1 = 0, offset2 = 0;
+    string_view hashes1 = {}, hashes2 = {};
+};
+
+// Resume point of a partitioning run, stored together with the rows of the chunks before it.
+struct run_checkpoint {
+    uint64_t chunk = 0, pairs = 0;
+    // Offsets of the first unprocessed records in the R1/R2 inputs.
+    uint64_t offset1 = 0, offset2 = 0;
+    // Run counters that can't be recomputed from the stored rows (scenario counts).
+    string counters;
+};
+
+// Destination of the classified read pairs: the SQLite `reads` table, the columnar store, partition buckets
+// or a manifest of record offsets.
+class readsStore {
+public:
+    virtual void bulk_insert(const std::pmr::vector<PE_row> &rows) = 0;
+
+    // Finishes the load, builds whatever index the backend needs.
+    virtual void end_bulk_load() = 0;
+
+    virtual double rows_per_sec() = 0;
+
+    // Stores that can resume a run commit it atomically with the rows inserted so far, the others ignore it.
+    virtual void checkpoint(const run_checkpoint &) {}
+
+    virtual ~readsStore() = default;
+};
+
+#endif //OMNIGRAPH_READSSTORE_HPP
@@ -0,0 +1,104 @@
+#ifndef OMNIGRAPH_RUNMETRICS_HPP
+#define OMNIGRAPH_RUNMETRICS_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+ * Run instrumentation: counters, gauges and histograms, grouped by the stage they were recorded in.
+ * Every update takes one mutex, so they belong at chunk or component granularity, per-read numbers are
+ * accumulated by the caller first.
+ *
+ * The output file is JSON, or TSV (stage, kind, name, value) when it ends with .tsv. It's rewritten
+ * (write + rename) every `interval_sec` by a background thread while the run goes on, and a last time
+ * by close(). Without an output file the metrics are only kept in memory.
+ */
+class runMetrics {
+
+    // log2 buckets: bucket b counts the values in [2^(b-1), 2^b), bucket 0 the values below 1.
+    struct histogram {
+        vector<uint64_t> buckets = vector<uint64_t>(64, 0);
+        uint64_t count = 0;
+        double sum = 0, min = 0, max = 0;
+
+        void observe(double value);
+
+        // Upper bound of the bucket holding the q-quantile, clamped to [min, max].
+        double quantile(double q) const;
+    };
+
+    struct stage_metrics {
+        string name;
+        chrono::steady_clock::time_point start, end;
+        bool running = true;
+        map<string, uint64_t> counters;
+        map<string, double> gauges;
+        map<string, histogram> histograms;
+    };
+
+    vector<stage_metrics> stages;
+    mutable mutex mtx;
+
+    string output_file;
+    thread periodic;
+    condition_variable cv_stop;
+    bool stopping = false;
+
+    // Current stage, an implicit "main" one before the first begin_stage().
+    stage_metrics &current();
+
+    void write_output();
+
+public:
+    explicit runMetrics(const string &output_file = "", double interval_sec = 0);
+
+    // Ends the running stage, if any.
+    void begin_stage(const string &name);
+    void end_stage();
+
+    void add(const string &counter, uint64_t value = 1);
+    void set(const string &gauge, double value);
+    void observe(const string &histogram, double value);
+
+    void json_export(ostream &out) const;
+    void tsv_export(ostream &out) const;
+
+    // Stops the periodic output and writes the final metrics.
+    void close();
+
+    ~runMetrics();
+
+    // "min:sec:milli" of a duration, as printed by the chunk logs.
+    static string format_ms(double ms);
+};
+
+// Records its lifetime in milliseconds into a histogram of `metrics` (may be null) when stopped or destroyed.
+class scopedTimer {
+
+    runMetrics *metrics;
+    string name;
+    chrono::steady_clock::time_point t1;
+    bool stopped = false;
+
+public:
+    scopedTimer(runMetrics *metrics, string name);
+
+    double elapsed_ms() const;
+
+    // Records the elapsed time once and returns it.
+    double stop();
+
+    ~scopedTimer();
+};
+
+
+#endif //OMNIGRAPH_RUNMETRICS_HPP
@@ -0,0 +1,84 @@
+#ifndef OMNIGRAPH_SEQENCODER_HPP
+#define OMNIGRAPH_SEQENCODER_HPP
+
+#include <kDataFrame.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Hash of a k-mer that contains a non-ACGT base, never looked up and counted as a miss.
+#define INVALID_KMER UINT64_MAX
+// Hash of a k-mer covering a low-quality base, never looked up and left out of the match ratios.
+#define MASKED_KMER (UINT64_MAX - 1)
+
+struct decoded_read {
+    string name;
+    string seq;
+    string qual;
+    vector<uint64_t> hashes;
+    // Byte offset of the record's header in the (uncompressed) input.
+    uint64_t offset = 0;
+};
+
+// SSE2/AVX2 kernels with a scalar fallback, selected once at startup from the running CPU.
+namespace seqEncoder {
+
+    // First '\n' in [begin, end) or nullptr.
+    const char *find_newline(const char *begin, const char *end);
+
+    // A,C,G,T (any case) -> 0,1,2,3 and everything else -> 4.
+    void encode_2bit(const char *seq, size_t length, uint8_t *codes);
+
+    const char *isa();
+
+    /*
+     * 2-bit packed sequence used for the reads table BLOBs:
+     * [uint32 length][uint32 N count][uint32 N positions ...][4 bases per byte, first base in the high bits]
+     * Any non-ACGT base is restored as 'N', lowercase bases come back uppercase.
+     */
+    // Upper bound of the packed size (every base an N), enough for pack() without scanning the sequence.
+    size_t max_packed_size(size_t length);
+
+    // Returns the number of bytes written, at most max_packed_size(length).
+    size_t pack(const char *seq, size_t length, uint8_t *out);
+
+    // False (and an empty `seq`) when the header, the N positions and `size` don't agree.
+    bool unpack(const uint8_t *blob, size_t size, string &seq);
+}
+
+/*
+ * Produces one hash per k-mer of a read.
+ * Integer hashing (mode 1) with k <= 32 is computed directly from the rolling 2-bit
+ * forward/reverse-complement words. Every other mode, including the default (mode 3, k = 75),
+ * hashes the k-mer text through kmerDecoder: k-mers with an N are skipped, the rest cost what they did before.
+ */
+class kmerHasher {
+
+    int kSize;
+    bool packed;
+    uint64_t mask;
+    kmerDecoder *KD;
+    vector<uint8_t> codes;
+    string kmer_buffer;
+
+public:
+    kmerHasher(int kSize, int hashing_mode = -1);
+
+    void hash_read(const char *seq, size_t length, vector<uint64_t> &hashes);
+
+    void hash_read(decoded_read &read) {
+        this->hash_read(read.seq.data(), read.seq.size(), read.hashes);
+    }
+
+    // Identifies the hash function, hashes persisted by one run are only reused by a run with the same signature.
+    static string signature(int kSize, int hashing_mode);
+
+    // Marks k-mers covering a base below min_quality (phred+33), returns the number masked.
+    static size_t mask_low_quality(decoded_read &read, int min_quality);
+
+    ~kmerHasher();
+};
+
+#endif //OMNIGRAPH_SEQENCODER_HPP
@@ -4,12 +4,19 @@
 #include <stdio.h>
 #include <sqlite3.h>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+#include <chrono>
 #include "iostream"
 #include "sqlite3pp.h"
+#include "readsStore.hpp"
 
 using namespace std;
 
-class SQLiteManager {
+
+class SQLiteManager : public readsStore {
 
 public:
     char *zErrMsg = 0;
@@ -18,12 +25,81 @@ public:
     static int callback(void *NotUsed, int argc, char **argv, char **azColName);
 
 
+    // Bulk loading state
+    int partitioning_mode = 1;
+    sqlite3_stmt *insert_stmt = nullptr;
+    uint64_t rows_in_transaction = 0;
+    uint64_t transaction_rows = 1000000;
+    chrono::high_resolution_clock::time_point bulk_start;
+    vector<uint8_t> packed_seq1, packed_seq2;
+
+    // Transactions only end at checkpoints, so the committed rows always match the last checkpoint.
+    bool checkpointing = false;
+    int64_t last_row_id = 0;
+
+    // Original components write-back state
+    sqlite3_stmt *stage_stmt[3] = {nullptr, nullptr, nullptr};
+    uint64_t staged_rows = 0;
+
+    void exec(const string &sql);
+
 public:
     sqlite3pp::database db;
+    uint64_t bulk_rows = 0;
+    // PE_seq1/PE_seq2 stored as seqEncoder 2-bit BLOBs instead of TEXT
+    bool packed_seqs = false;
+    // seq1_hashes/seq2_hashes BLOB columns holding the k-mer hashes of the stored sequences (hierarchical mode)
+    bool persist_hashes = false;
+
     SQLiteManager(const string& db_file);
-    void create_reads_table(int partitioning_mode);
+    // The components index is not created here, see create_reads_index() / end_bulk_load().
+    // An existing table keeps the sequence encoding and hash columns it was created with.
+    void create_reads_table(int partitioning_mode, bool packed_seqs = false, bool persist_hashes = false);
+    void create_reads_index();
     bool check_reads_table();
-    void insert_PE(string & R1, string & R2, int & collectiveComp1, int & collectiveComp2);
+
+    /*
+     * Bulk loading: one persistent INSERT statement, large transactions and no journal.
+     * Rows are committed every `transaction_rows` or on commit(), the components index is
+     * built and ANALYZE runs once in end_bulk_load().
+     */
+    void begin_bulk_load(int partitioning_mode, const string &journal_mode = "OFF", uint64_t transaction_rows = 1000000);
+    void bulk_insert(const PE_row &row);
+    void bulk_insert(const std::pmr::vector<PE_row> &rows) override;
+    void commit();
+    void end_bulk_load() override;
+
+    /*
+     * Resumable runs: must be enabled before begin_bulk_load(), which then runs in WAL mode with synchronous=NORMAL.
+     * checkpoint() is written in the current transaction, which is committed once it holds `transaction_rows`.
+     * resume_checkpoint() loads the last committed checkpoint (false without one) and drops the rows after it,
+     * so the run continues from there without duplicates. It exits if the reads table has rows but no checkpoint.
+     */
+    void enable_checkpoints();
+    void checkpoint(const run_checkpoint &state) override;
+    bool resume_checkpoint(run_checkpoint &state);
+    double rows_per_sec() override;
+
+    /*
+     * Original components write-back of the hierarchical mode: the (ID, mate, component) labels are
+     * staged into a TEMP table in one transaction, then applied with a single UPDATE ... FROM join.
+     * Mates that are never staged keep their original component (0).
+     */
+    void begin_components_update();
+    void stage_component(int R_ID, int64_t ID, int64_t comp);
+    // Returns the number of updated reads.
+    uint64_t end_components_update();
+
+    // Decodes a PE_seq column whether it holds TEXT or a packed BLOB, false for a malformed BLOB.
+    static bool read_seq(const sqlite3pp::query::rows &row, int idx, string &seq);
+
+    // Persisted k-mer hashes of a seqN_hashes column, false when the column is NULL.
+    static bool read_hashes(const sqlite3pp::query::rows &row, int idx, vector<uint64_t> &hashes);
+
+    // `meta` table key/value, "" when missing.
+    void set_meta(const string &key, const string &value);
+    string get_meta(const string &key);
+
     void close();
 
 };
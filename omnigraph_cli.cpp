@@ -0,0 +1,369 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <kDataFrame.hpp>
+#include "INIReader.h"
+#include "queryServer.hpp"
+#include "cdbgLabeling.hpp"
+#include "primaryPartitioning.hpp"
+#include "finalCompsDumper.hpp"
+
+using namespace std;
+
+/*
+ * Pipeline driver: `omnigraph run` chains cDBG labeling, primary partitioning and the final components dump
+ * in one process, handing the index, pairs counts and final components map over in memory. The stages and
+ * their inputs come from the INI config ([pipeline] and the existing sections), `label`, `partition` and
+ * `dump` run a single stage from the artifacts of the previous one.
+ *
+ * Resident index mode: `omnigraph serve` loads the labeled cDBG once and answers classification requests
+ * over a UNIX domain socket (see queryServer.hpp for the protocol), `omnigraph query` is the thin client.
+ */
+
+void usage() {
+    cerr << "run: ./omnigraph <command> [options]" << endl;
+    cerr << "commands:" << endl;
+    cerr << "  run [--stages <label,partition,dump>]" << endl;
+    cerr << "        run the pipeline stages in one process (default: [pipeline] stages)" << endl;
+    cerr << "  label | partition | dump" << endl;
+    cerr << "        run one stage, reading the previous stage's artifacts from disk" << endl;
+    cerr << "  serve <labeled_cDBG_prefix> [--socket <path>] [--hashing-mode <N>]" << endl;
+    cerr << "        keep the index loaded and classify reads sent to the socket" << endl;
+    cerr << "  query [--socket <path>] <reads.fa|reads.fq|-> ..." << endl;
+    cerr << "        classify reads files (read by the server) or FASTA/FASTQ on stdin (-), prints" << endl;
+    cerr << "        <read>\\t<mapped>\\t<scenario>\\t<component>" << endl;
+    cerr << "  ping [--socket <path>]" << endl;
+    cerr << "  shutdown [--socket <path>]" << endl;
+    cerr << "--config <ini>: config of run, label, partition, dump and serve (default: ../config.ini)" << endl;
+    cerr << "default socket: omnigraph.sock" << endl;
+    exit(1);
+}
+
+// Sends FASTA/FASTQ records from stdin as SEQ requests.
+void send_stdin_reads(lineChannel &channel) {
+    string line, name, seq;
+    bool has_record = false;
+    auto send_record = [&]() {
+        if (has_record) channel.write("SEQ " + name + " " + seq + "\n");
+        seq.clear();
+    };
+
+    while (getline(cin, line)) {
+        if (line.empty()) continue;
+        if (line[0] == '>' || line[0] == '@') {
+            send_record();
+            name = line.substr(1, line.find_first_of(" \t") - 1);
+            has_record = true;
+            if (line[0] == '@') {
+                // FASTQ: sequence, '+', quality
+                getline(cin, seq);
+                getline(cin, line);
+                getline(cin, line);
+            }
+        } else {
+            seq.append(line);
+        }
+    }
+    send_record();
+}
+
+int query(const string &socket_path, const vector<string> &inputs) {
+    int fd = connect_query_socket(socket_path);
+    if (fd == -1) {
+        cerr << "could not connect to " << socket_path << ", is `omnigraph serve` running?" << endl;
+        return 1;
+    }
+
+    // Requests are pipelined from a writer thread while the answers are printed as they come.
+    thread writer([fd, &inputs]() {
+        lineChannel channel(fd);
+        for (const auto &input : inputs) {
+            if (input == "-") {
+                send_stdin_reads(channel);
+                continue;
+            }
+            char resolved[PATH_MAX];
+            if (!realpath(input.c_str(), resolved)) {
+                cerr << "could not find " << input << endl;
+                continue;
+            }
+            channel.write("FILE " + string(resolved) + "\n");
+        }
+        channel.write("QUIT\n");
+        channel.flush();
+    });
+
+    auto t1 = chrono::high_resolution_clock::now();
+    lineChannel channel(fd);
+    string line;
+    uint64_t answers = 0;
+    int status = 0;
+    while (channel.read_line(line)) {
+        if (line.compare(0, 3, "OK ") == 0) {
+            cerr << line << endl;
+        } else if (line.compare(0, 4, "ERR ") == 0) {
+            cerr << line << endl;
+            status = 1;
+        } else {
+            cout << line << '\n';
+            answers++;
+        }
+    }
+    writer.join();
+    close(fd);
+
+    auto ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "%lu reads classified in %.1f ms\n", (unsigned long) answers, ms);
+    return status;
+}
+
+int request(const string &socket_path, const string &command) {
+    int fd = connect_query_socket(socket_path);
+    if (fd == -1) {
+        cerr << "could not connect to " << socket_path << endl;
+        return 1;
+    }
+    lineChannel channel(fd);
+    channel.write(command + "\nQUIT\n");
+    channel.flush();
+    string line;
+    while (channel.read_line(line)) cout << line << endl;
+    close(fd);
+    return 0;
+}
+
+// Stages of a comma-separated list, in pipeline order.
+vector<string> parse_stages(const string &list) {
+    const vector<string> known = {"label", "partition", "dump"};
+    vector<string> stages;
+    string stage;
+    istringstream iss(list);
+    while (getline(iss, stage, ',')) {
+        stage.erase(0, stage.find_first_not_of(" \t"));
+        stage.erase(stage.find_last_not_of(" \t") + 1);
+        if (stage.empty()) continue;
+        if (find(known.begin(), known.end(), stage) == known.end()) {
+            throw runtime_error("unknown stage: " + stage);
+        }
+        stages.push_back(stage);
+    }
+    vector<string> ordered;
+    for (const auto &name : known) {
+        if (find(stages.begin(), stages.end(), name) != stages.end()) ordered.push_back(name);
+    }
+    return ordered;
+}
+
+/*
+ * Runs the selected stages, a stage's output stays in memory when the next stage runs too and is only
+ * written to disk when the [pipeline] save_index/export_pairs/export_components flags ask for it or no
+ * later stage of this run consumes it. The reads store of the partitioning is always written.
+ */
+int run_pipeline(INIReader &reader, const vector<string> &stages) {
+    auto runs = [&stages](const string &name) {
+        return find(stages.begin(), stages.end(), name) != stages.end();
+    };
+
+    // -1 when not configured, the partition stage then takes them from the index.
+    int config_kSize = reader.GetInteger("kProcessor", "ksize", -1);
+    int config_hashing_mode = reader.GetInteger("kProcessor", "hashing_mode", -1);
+    int kSize = config_kSize == -1 ? 31 : config_kSize;
+    int hashing_mode = config_hashing_mode == -1 ? 3 : config_hashing_mode;
+    string index_prefix = reader.Get("kProcessor", "idx_prefix", "");
+    string out_prefix = reader.Get("pipeline", "out_prefix", "omnigraph");
+    int threads = max(1, (int) reader.GetInteger("pipeline", "threads", 1));
+    auto cutoff = (uint32_t) reader.GetInteger("pipeline", "cutoff", 1);
+    string store_type = reader.Get("pipeline", "store", "sqlite");
+    int max_open_files = reader.GetInteger("output_fasta", "max_open_files", 512);
+    int gzip_level = reader.GetInteger("output_fasta", "gzip_level", 0);
+    int gzip_threads = reader.GetInteger("output_fasta", "gzip_threads", 4);
+
+    if (runs("dump") && store_type == "partitions") {
+        cerr << "the dump stage can't read a `partitions` store, use sqlite, columnar or manifest." << endl;
+        return 1;
+    }
+
+    auto t1 = chrono::high_resolution_clock::now();
+    kDataFrame *kf = nullptr;
+    partitioning_result partitioned;
+    runMetrics metrics(reader.Get("metrics", "file", ""), reader.GetReal("metrics", "interval_sec", 0));
+
+    if (runs("label")) {
+        string cdbg_fasta = reader.Get("pipeline", "cdbg_fasta", "");
+        string cdbg_names = reader.Get("pipeline", "cdbg_names", "");
+        if (cdbg_fasta.empty() || cdbg_names.empty()) {
+            cerr << "the label stage needs [pipeline] cdbg_fasta and cdbg_names." << endl;
+            return 1;
+        }
+        cerr << "[label] " << cdbg_fasta << endl;
+        kf = label_cDBG(cdbg_fasta, cdbg_names, kSize, hashing_mode, &metrics);
+        if (reader.GetBoolean("pipeline", "save_index", false) || !runs("partition")) {
+            if (index_prefix.empty()) {
+                cerr << "saving the labeled cDBG needs [kProcessor] idx_prefix." << endl;
+                return 1;
+            }
+            cerr << "[label] saving the labeled cDBG to " << index_prefix << endl;
+            kf->save(index_prefix);
+        }
+    }
+
+    if (runs("partition")) {
+        if (!kf) {
+            cerr << "[partition] loading the labeled cDBG " << index_prefix << endl;
+            scopedTimer timer(&metrics, "load_index_ms");
+            kf = kDataFrame::load(index_prefix);
+        }
+        // Reads hashed differently from the index would all come back unmapped.
+        int index_kSize = (int) kf->getkSize();
+        int index_hashing_mode = kf->getkmerDecoder()->get_hashing_mode();
+        if ((config_kSize != -1 && config_kSize != index_kSize) ||
+            (config_hashing_mode != -1 && config_hashing_mode != index_hashing_mode)) {
+            cerr << "[partition] the config asks for k=" << config_kSize << ", hashing_mode=" << config_hashing_mode
+                 << " but the index was built with k=" << index_kSize << ", hashing_mode=" << index_hashing_mode
+                 << "." << endl;
+            delete kf;
+            return 1;
+        }
+        partitioning_options options;
+        options.PE_1_reads_file = reader.Get("Reads", "read1", "");
+        options.PE_2_reads_file = reader.Get("Reads", "read2", "");
+        options.out_prefix = out_prefix;
+        options.batchSize = reader.GetInteger("kProcessor", "chunk_size", options.batchSize);
+        options.no_of_sequences = reader.GetInteger("Reads", "seqs_no", options.no_of_sequences);
+        options.hashing_mode = index_hashing_mode;
+        options.readahead_mb = reader.GetInteger("Reads", "readahead_mb", 64);
+        options.min_quality = reader.GetInteger("Reads", "min_quality", 0);
+        options.target_chunk_ms = reader.GetReal("kProcessor", "target_chunk_ms", 0);
+        options.max_chunk_mb = reader.GetInteger("kProcessor", "max_chunk_mb", 0);
+        options.packed_seqs = reader.GetBoolean("SQLite", "packed_seqs", false);
+        options.store_type = store_type;
+        options.max_open_files = max_open_files;
+        options.gzip_level = gzip_level;
+        options.gzip_threads = gzip_threads;
+        options.cutoff = cutoff;
+        options.threads = threads;
+        options.original_comps_file = reader.Get("pipeline", "orig_comps", "");
+        options.resume = reader.GetBoolean("pipeline", "resume", false);
+        options.export_pairs = reader.GetBoolean("pipeline", "export_pairs", false) || !runs("dump");
+        options.export_components = reader.GetBoolean("pipeline", "export_components", false) || !runs("dump");
+        options.metrics = &metrics;
+        cerr << "[partition] " << options.PE_1_reads_file << " " << options.PE_2_reads_file << endl;
+        primary_partitioning(kf, options, partitioned);
+        delete partitioned.pairs;
+        partitioned.pairs = nullptr;
+    }
+    delete kf;
+
+    if (runs("dump")) {
+        if (!partitioned.components) {
+            string map_file = out_prefix + "_finalComponents.bin";
+            cerr << "[dump] loading the final components map " << map_file << endl;
+            partitioned.components = new finalComponents();
+            partitioned.components->binary_import(map_file);
+            if (store_type == "columnar") partitioned.reads_path = out_prefix + "_omni.cols";
+            else if (store_type == "manifest") partitioned.reads_path = out_prefix + "_omni.manifest";
+            else partitioned.reads_path = out_prefix + "_omni.db";
+        }
+        dump_options options;
+        options.out_dir = reader.Get("pipeline", "dump_dir", "");
+        if (options.out_dir.empty()) {
+            string base_name = out_prefix.substr(out_prefix.rfind('/') + 1);
+            options.out_dir = "dumped_partitions_cutoff" + to_string(partitioned.components->cutoff) + "_" + base_name;
+        }
+        options.threads = threads;
+        options.max_open_files = max_open_files;
+        options.gzip_level = gzip_level;
+        options.gzip_threads = gzip_threads;
+        options.metrics = &metrics;
+        cerr << "[dump] " << partitioned.reads_path << " -> " << options.out_dir << endl;
+        dump_final_components(partitioned.reads_path, *partitioned.components, options);
+    }
+    delete partitioned.components;
+    metrics.close();
+
+    auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "Pipeline done in %.1fs.\n", sec);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) usage();
+
+    string command = argv[1];
+    string socket_path = "omnigraph.sock";
+    string config_file_path = "../config.ini";
+    string stages;
+    vector<string> positional;
+    int hashing_mode = -1;
+
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (option == "--hashing-mode" && i + 1 < argc) {
+            hashing_mode = stoi(argv[++i]);
+        } else if (option == "--config" && i + 1 < argc) {
+            config_file_path = argv[++i];
+        } else if (option == "--stages" && i + 1 < argc) {
+            stages = argv[++i];
+        } else if (option.size() > 2 && option.compare(0, 2, "--") == 0) {
+            cerr << "unknown option: " << option << endl;
+            usage();
+        } else {
+            positional.push_back(option);
+        }
+    }
+
+    INIReader reader(config_file_path);
+    if (command == "run" || command == "label" || command == "partition" || command == "dump") {
+        if (reader.ParseError() != 0) {
+            cerr << "Can't load '" << config_file_path << "'" << endl;
+            return 1;
+        }
+        if (command != "run") stages = command;
+        else if (stages.empty()) stages = reader.Get("pipeline", "stages", "label,partition,dump");
+        try {
+            return run_pipeline(reader, parse_stages(stages));
+        } catch (const runtime_error &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    if (hashing_mode == -1 && reader.ParseError() == 0) {
+        hashing_mode = reader.GetInteger("kProcessor", "hashing_mode", -1);
+    }
+
+    if (command == "serve") {
+        if (positional.size() != 1) usage();
+        cerr << "Loading the labeled cDBG ..." << endl;
+        auto t1 = chrono::high_resolution_clock::now();
+        kDataFrame *kf = kDataFrame::load(positional[0]);
+        auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+        fprintf(stderr, "Labeled cDBG loaded in %.1fs\n", sec);
+
+        queryServer server(kf, (int) kf->getkSize(), hashing_mode, socket_path);
+        bool served = server.run();
+        fprintf(stderr, "Served %lu reads in %lu requests.\n", (unsigned long) server.served_reads.load(),
+                (unsigned long) server.served_requests.load());
+        delete kf;
+        return served ? 0 : 1;
+    } else if (command == "query") {
+        if (positional.empty()) usage();
+        return query(socket_path, positional);
+    } else if (command == "ping") {
+        return request(socket_path, "PING");
+    } else if (command == "shutdown") {
+        return request(socket_path, "SHUTDOWN");
+    }
+
+    usage();
+    return 1;
+}
@@ -1,49 +1,11 @@
 #include <iostream>
 #include <kDataFrame.hpp>
 #include <string>
-#include <utility>
-#include <vector>
-#include <cstdint>
-#include <firstQuery.hpp>
-#include "INIReader.h"
-#include "omnigraph.hpp"
-#include <cassert>
-#include "parallel_hashmap/phmap_dump.h"
+#include "primaryPartitioning.hpp"
 
 using namespace std;
 
 
-class pairs_count {
-public:
-    flat_hash_map<pair<uint32_t, uint32_t>, uint32_t> counts;
-    string prefix;
-
-    explicit pairs_count(string prefix) {
-        this->prefix = std::move(prefix);
-    }
-
-    void insert_pair(uint32_t &comp1, uint32_t &comp2) {
-        this->counts[make_pair(std::min(comp1, comp2), std::max(comp1, comp2))]++;
-    }
-
-
-    void tsv_export() {
-        ofstream tsvWriter(this->prefix + "_pairsCount.tsv");
-        tsvWriter << "comp1\tcomp2\tcount\n";
-        for (auto &pair : this->counts) {
-            string line = to_string(get<0>(pair.first)) + '\t';
-            line.append(to_string(get<1>(pair.first)) + '\t');
-            line.append(to_string(pair.second) + '\n');
-            tsvWriter << line;
-        }
-
-        tsvWriter.close();
-
-    }
-
-};
-
-
 int main(int argc, char **argv) {
 
 
@@ -51,215 +13,106 @@ int main(int argc, char **argv) {
     // Index prefix
     // Read 1
     // Read 2
-    string index_prefix, PE_1_reads_file, PE_2_reads_file, out_prefix;
-    int batchSize = 10000;
-    int kSize = 75;
-    int no_of_sequences = 67954363;
-    int hashing_mode = 3;
+    string index_prefix;
+    partitioning_options options;
+    string metrics_file;
+    double metrics_interval = 0;
 
     // Temporary solution for the Farm IO
-    if (argc < 4) {
-        cerr << "run: ./primaryPartitioning <index_prefix> <PE_R1> <PE_R2> <out_prefix>" << endl;
+    if (argc < 5) {
+        cerr << "run: ./primaryPartitioning <index_prefix> <PE_R1> <PE_R2> <out_prefix> [options]" << endl;
+        cerr << "options:" << endl;
+        cerr << "  --readahead-mb <MB>        async prefetch window per reads file (default: 64)" << endl;
+        cerr << "  --min-quality <phred>      mask kmers covering low-quality FASTQ bases (default: off)" << endl;
+        cerr << "  --batch-size <reads>       (initial) reads per chunk (default: 10000)" << endl;
+        cerr << "  --target-chunk-ms <ms>     tune the batch size toward this chunk latency (default: off)" << endl;
+        cerr << "  --max-chunk-mb <MB>        upper bound on the chunk memory when tuning (default: none)" << endl;
+        cerr << "  --packed-seqs              store reads as 2-bit packed BLOBs instead of TEXT" << endl;
+        cerr << "  --store <sqlite|columnar|partitions|manifest>" << endl;
+        cerr << "                             reads store backend, partitions writes per-component FASTA buckets," << endl;
+        cerr << "                             manifest only records offsets for dump_partitions (default: sqlite)" << endl;
+        cerr << "  --max-open-files <N>       open bucket files limit for --store partitions (default: 512)" << endl;
+        cerr << "  --gzip-level <1-9>         gzip the --store partitions buckets (default: off)" << endl;
+        cerr << "  --gzip-threads <N>         compression worker threads (default: 4)" << endl;
+        cerr << "  --threads <N>              classification threads (default: 1)" << endl;
+        cerr << "  --cutoff <N>               ignore pairs counts below N when merging final components (default: 1)" << endl;
+        cerr << "  --orig-comps <csv>         original components CSV, so components without reads get a final ID too" << endl;
+        cerr << "  --resume                   checkpoint every transaction and continue from the last checkpoint of" << endl;
+        cerr << "                             <out_prefix>_omni.db if there is one (--store sqlite only)" << endl;
+        cerr << "  --metrics <file>           write the run metrics as JSON (TSV for a .tsv file)" << endl;
+        cerr << "  --metrics-interval <sec>   also rewrite the metrics file periodically during the run" << endl;
         exit(1);
     } else {
         index_prefix = argv[1];
-        PE_1_reads_file = argv[2];
-        PE_2_reads_file = argv[3];
-        out_prefix = argv[4];
+        options.PE_1_reads_file = argv[2];
+        options.PE_2_reads_file = argv[3];
+        options.out_prefix = argv[4];
     }
 
-    string sqlite_db = out_prefix + "_omni.db";
-
-    cerr << "Processing: \nR1: " << PE_1_reads_file << "\nR2: " << PE_2_reads_file << endl;
-
-    // Instantiations
-    auto *originalCompsQuery = new Omnigraph();
-    auto *SQL = new SQLiteManager(sqlite_db);
-    SQL->create_reads_table(originalCompsQuery->partitioning_mode);
-
-    // Instantiate kmerDecoder with hashing mode 3
-    kmerDecoder *READ_1_KMERS = new Kmers(PE_1_reads_file, batchSize, kSize);
-    READ_1_KMERS->setHashingMode(hashing_mode);
-    kmerDecoder *READ_2_KMERS = new Kmers(PE_2_reads_file, batchSize, kSize);
-    READ_2_KMERS->setHashingMode(hashing_mode);
-
-    // Initializations
-    int no_chunks = ceil((double) no_of_sequences / (double) batchSize);
-    int current_chunk = 0;
-
-
-    // kProcessor Index Loading
-    std::cerr << "Loading labeled cDBG ..." << std::endl;
-    kDataFrame *kf = kDataFrame::load(index_prefix);
-    assert(kSize == (int) kf->getkSize());
-    std::cerr << "Labeled cDBG loaded successfully ..." << std::endl;
-
-    auto *pairsCounter = new pairs_count(out_prefix);
-
-    while (!READ_1_KMERS->end() && !READ_2_KMERS->end()) {
-
-        cerr << "processing chunk: (" << ++current_chunk << ") / (" << no_chunks << ") ... ";
-        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
-
-        READ_1_KMERS->next_chunk();
-        READ_2_KMERS->next_chunk();
-
-
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1 = READ_1_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2 = READ_2_KMERS->getKmers()->begin();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq1_end = READ_1_KMERS->getKmers()->end();
-        flat_hash_map<std::string, std::vector<kmer_row>>::iterator seq2_end = READ_2_KMERS->getKmers()->end();
-
-        vector<tuple<string, string, uint32_t, uint32_t>> sqlite_chunk; // Buffer for holding Sqlite rows
-
-        while (seq1 != seq1_end && seq2 != seq2_end) {
-            tuple<string, bool, int, uint64_t> read_1_result = originalCompsQuery->classifyRead(kf, seq1->second, 1);
-            tuple<string, bool, int, uint64_t> read_2_result = originalCompsQuery->classifyRead(kf, seq2->second, 2);
-
-            string R1_constructedRead = get<0>(read_1_result);
-//            bool read_1_mapped_flag = get<1>(read_1_result);
-            uint32_t R1_connectedComponent = get<3>(read_1_result);
-
-            string R2_constructedRead = get<0>(read_2_result);
-//            bool read_2_mapped_flag = get<1>(read_2_result);
-            uint32_t R2_connectedComponent = get<3>(read_2_result);
-
-            // Pairs counter
-            if ((get<1>(read_1_result) && get<1>(read_2_result)) && (R1_connectedComponent != R2_connectedComponent)) {
-                pairsCounter->insert_pair(R1_connectedComponent, R2_connectedComponent);
+    for (int i = 5; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--readahead-mb" && i + 1 < argc) {
+            options.readahead_mb = stoi(argv[++i]);
+        } else if (option == "--min-quality" && i + 1 < argc) {
+            options.min_quality = stoi(argv[++i]);
+        } else if (option == "--batch-size" && i + 1 < argc) {
+            options.batchSize = stoi(argv[++i]);
+        } else if (option == "--target-chunk-ms" && i + 1 < argc) {
+            options.target_chunk_ms = stod(argv[++i]);
+        } else if (option == "--max-chunk-mb" && i + 1 < argc) {
+            options.max_chunk_mb = stoi(argv[++i]);
+        } else if (option == "--packed-seqs") {
+            options.packed_seqs = true;
+        } else if (option == "--max-open-files" && i + 1 < argc) {
+            options.max_open_files = stoi(argv[++i]);
+        } else if (option == "--gzip-level" && i + 1 < argc) {
+            options.gzip_level = stoi(argv[++i]);
+        } else if (option == "--gzip-threads" && i + 1 < argc) {
+            options.gzip_threads = stoi(argv[++i]);
+        } else if (option == "--threads" && i + 1 < argc) {
+            options.threads = max(1, stoi(argv[++i]));
+        } else if (option == "--cutoff" && i + 1 < argc) {
+            options.cutoff = stoul(argv[++i]);
+        } else if (option == "--orig-comps" && i + 1 < argc) {
+            options.original_comps_file = argv[++i];
+        } else if (option == "--metrics" && i + 1 < argc) {
+            metrics_file = argv[++i];
+        } else if (option == "--metrics-interval" && i + 1 < argc) {
+            metrics_interval = stod(argv[++i]);
+        } else if (option == "--resume") {
+            options.resume = true;
+        } else if (option == "--store" && i + 1 < argc) {
+            options.store_type = argv[++i];
+            if (options.store_type != "sqlite" && options.store_type != "columnar"
+                && options.store_type != "partitions" && options.store_type != "manifest") {
+                cerr << "unknown store: " << options.store_type << endl;
+                exit(1);
             }
-
-
-            sqlite_chunk.emplace_back(
-                    make_tuple(R1_constructedRead, R2_constructedRead, R1_connectedComponent, R2_connectedComponent));
-
-            seq1++;
-            seq2++;
-        }
-
-        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-        auto milli = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
-        long hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        long min = milli / 60000;
-        milli = milli - 60000 * min;
-        long sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cerr << "Done in: ";
-        cerr << min << ":" << sec << ":" << milli;
-
-
-        // --------------------------------------------------------------------------------
-        //                                      SQLITE Insertion                          |
-        // --------------------------------------------------------------------------------
-
-        sqlite3_mutex_enter(sqlite3_db_mutex(SQL->db.db_));
-        char *errorMessage;
-        sqlite3_exec(SQL->db.db_, "PRAGMA synchronous=OFF", nullptr, nullptr, &errorMessage);
-        sqlite3_exec(SQL->db.db_, "PRAGMA count_changes=OFF", nullptr, nullptr, &errorMessage);
-        sqlite3_exec(SQL->db.db_, "PRAGMA journal_mode=MEMORY", nullptr, nullptr, &errorMessage);
-        sqlite3_exec(SQL->db.db_, "PRAGMA temp_store=MEMORY", nullptr, nullptr, &errorMessage);
-        sqlite3_exec(SQL->db.db_, "BEGIN TRANSACTION", nullptr, nullptr, &errorMessage);
-        char const *szSQL = "INSERT INTO reads (PE_seq1, PE_seq2, seq1_original_component, seq2_original_component) VALUES (?,?,?,?);";
-        sqlite3_stmt *stmt;
-        SQL->rc = sqlite3_prepare(SQL->db.db_, szSQL, -1, &stmt, nullptr);
-
-
-        if (SQL->rc == SQLITE_OK) {
-
-            for (auto &row : sqlite_chunk) {
-                char const *R1_seq = get<0>(row).c_str();
-                char const *R2_seq = get<1>(row).c_str();
-
-                sqlite3_bind_text(stmt, 1, R1_seq, strlen(R1_seq), nullptr);
-                sqlite3_bind_text(stmt, 2, R2_seq, strlen(R2_seq), nullptr);
-                sqlite3_bind_int64(stmt, 3, get<2>(row));
-                sqlite3_bind_int64(stmt, 4, get<3>(row));
-
-                int retVal = sqlite3_step(stmt);
-                if (retVal != SQLITE_DONE) {
-                    printf("Commit Failed! %d\n", retVal);
-                }
-
-                sqlite3_reset(stmt);
-            }
-            sqlite3_exec(SQL->db.db_, "COMMIT TRANSACTION", NULL, NULL, &errorMessage);
-            sqlite3_finalize(stmt);
-
         } else {
-            fprintf(stderr, "SQL error: %s\n", SQL->zErrMsg);
-            sqlite3_free(SQL->zErrMsg);
+            cerr << "unknown option: " << option << endl;
+            exit(1);
         }
-        sqlite3_mutex_leave(sqlite3_db_mutex(SQL->db.db_));
-
-        // --------------------------------------------------------------------------------
-        //                                      Done Insertion                          |
-        // --------------------------------------------------------------------------------
-
-
-        // Calculating Inserting Time Only
-        std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
-        milli = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count();
-        hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        min = milli / 60000;
-        milli = milli - 60000 * min;
-        sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cerr << " | inserted in: ";
-        cerr << min << ":" << sec << ":" << milli;
-
-        // Calculating Total Time
-        std::chrono::high_resolution_clock::time_point t4 = std::chrono::high_resolution_clock::now();
-        milli = std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t1).count();
-        hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        min = milli / 60000;
-        milli = milli - 60000 * min;
-        sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cerr << " | total : ";
-        cerr << min << ":" << sec << ":" << milli << endl;
-
     }
 
+    if (options.resume && options.store_type != "sqlite") {
+        cerr << "--resume needs --store sqlite." << endl;
+        exit(1);
+    }
 
-    // --------------------------------------------------------------------------------
-    //                                Dumping pairCounts TSV                          |
-    // --------------------------------------------------------------------------------
-
-    cerr << "Dumping pairCounter ..." << endl;
-    pairsCounter->tsv_export();
-
-    // --------------------------------------------------------------------------------
-    //                              Dumping pairCounts TSV Done                       |
-    // --------------------------------------------------------------------------------
-
-
-    // Printing a summary report
-
-    for (int p = 1; p <= 2; p++) {
-        double total = 0;
-        for (int scenario = 1; scenario <= 6; scenario++)
-            total += originalCompsQuery->scenarios_count[p][scenario];
-
-        double mapped_percentage = (originalCompsQuery->scenarios_count[p][1] +
-                                    originalCompsQuery->scenarios_count[p][5]);
-        mapped_percentage = (mapped_percentage / total) * 100;
+    // kProcessor Index Loading
+    std::cerr << "Loading labeled cDBG ..." << std::endl;
+    kDataFrame *kf = kDataFrame::load(index_prefix);
+    std::cerr << "Labeled cDBG loaded successfully ..." << std::endl;
 
-        cout << "Paired End File: " << p << " | mapped_reads  %" << mapped_percentage << endl;
-        for (int scenario = 1; scenario <= 6; scenario++) {
-            int count = originalCompsQuery->scenarios_count[p][scenario];
-            string description = originalCompsQuery->scenario_descriptions[scenario];
-            cout << "Scenario (" << scenario << ") : Count: " << count << " | " << description << endl;
-        }
-        cout << "---------------------------------" << endl;
-    }
+    runMetrics metrics(metrics_file, metrics_interval);
+    options.metrics = &metrics;
+    partitioning_result result;
+    primary_partitioning(kf, options, result);
+    metrics.close();
 
-    SQL->close();
+    delete result.pairs;
+    delete result.components;
     delete kf;
-    delete READ_1_KMERS;
-    delete READ_2_KMERS;
 
     return 0;
 }
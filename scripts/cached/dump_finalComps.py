@@ -22,12 +22,34 @@ from collections import defaultdict
 import os
 from tqdm import tqdm
 import multiprocessing
+import struct
 import plotly.graph_objs as go
 from plotly.offline import plot
 from collections import Counter
 import click
 
 
+
+# Reads tables written with packed sequences store PE_seq1/PE_seq2 as 2-bit BLOBs:
+# [uint32 length][uint32 N count][uint32 N positions ...][4 bases per byte, first base in the high bits]
+_BYTE_TO_BASES = [''.join("ACGT"[(b >> shift) & 3] for shift in (6, 4, 2, 0)) for b in range(256)]
+
+
+def decode_seq(value):
+    if not isinstance(value, bytes):
+        return value
+    length, n_count = struct.unpack_from("<II", value, 0)
+    n_positions = struct.unpack_from(f"<{n_count}I", value, 8)
+    packed = value[8 + 4 * n_count:]
+    seq = ''.join(_BYTE_TO_BASES[b] for b in packed)[:length]
+    if n_count:
+        seq = list(seq)
+        for pos in n_positions:
+            seq[pos] = 'N'
+        seq = ''.join(seq)
+    return seq
+
+
 class ConnectedComponents:
 
     def __init__(self, min_count=1):
@@ -248,13 +270,15 @@ def main(no_cores, cutoff_threshold, sqlite_db_path, unitigs_path, pairsCountFil
         with open(file_path, 'w') as fastaWriter:
             for row in read_1_curs:
                 if (row[3] and row[4]) and (row[3] != row[4]):
-                    all_lengths.append(len(row[1]))
-                    fastaWriter.write(f">{row[0]}.1\t{_finalCompID}\n{row[1]}\n")
+                    seq = decode_seq(row[1])
+                    all_lengths.append(len(seq))
+                    fastaWriter.write(f">{row[0]}.1\t{_finalCompID}\n{seq}\n")
 
             for row in read_2_curs:
                 if (row[3] and row[4]) and (row[3] != row[4]):
-                    all_lengths.append(len(row[2]))
-                    fastaWriter.write(f">{row[0]}.2\t{_finalCompID}\n{row[2]}\n")
+                    seq = decode_seq(row[2])
+                    all_lengths.append(len(seq))
+                    fastaWriter.write(f">{row[0]}.2\t{_finalCompID}\n{seq}\n")
 
         conn.close()
 
@@ -11,6 +11,10 @@ Output:
     2. TSV with col1:finalCompID col2:originalComponentsIDs
 
 
+The native `dump_finalComps` executable produces the same partitions with a single scan of the reads
+(SQLite DB, columnar store or manifest) and should be preferred for large runs. It numbers them by smallest
+original component instead of by first appearance in the pairs count file.
+
 Run:
 python dump_finalComps.py <db_file> <pairsCountFile> <originalComponentsCSV> <no_cores> <optional: cutoff (default: 1)>
 """
@@ -21,6 +25,27 @@ from collections import defaultdict
 import os
 from tqdm import tqdm
 import multiprocessing
+import struct
+
+
+# Reads tables written with packed sequences store PE_seq1/PE_seq2 as 2-bit BLOBs:
+# [uint32 length][uint32 N count][uint32 N positions ...][4 bases per byte, first base in the high bits]
+_BYTE_TO_BASES = [''.join("ACGT"[(b >> shift) & 3] for shift in (6, 4, 2, 0)) for b in range(256)]
+
+
+def decode_seq(value):
+    if not isinstance(value, bytes):
+        return value
+    length, n_count = struct.unpack_from("<II", value, 0)
+    n_positions = struct.unpack_from(f"<{n_count}I", value, 8)
+    packed = value[8 + 4 * n_count:]
+    seq = ''.join(_BYTE_TO_BASES[b] for b in packed)[:length]
+    if n_count:
+        seq = list(seq)
+        for pos in n_positions:
+            seq[pos] = 'N'
+        seq = ''.join(seq)
+    return seq
 
 
 class ConnectedComponents:
@@ -202,8 +227,8 @@ def perform_writing(params):
             read_curs = conn.execute(read_sql)
             rows = read_curs.fetchall()
             for row in rows:
-                fastaWriter.write(f">{row[0]}.1\t{row[3]}\n{row[1]}\n")
-                fastaWriter.write(f">{row[0]}.2\t{row[4]}\n{row[2]}\n")
+                fastaWriter.write(f">{row[0]}.1\t{row[3]}\n{decode_seq(row[1])}\n")
+                fastaWriter.write(f">{row[0]}.2\t{row[4]}\n{decode_seq(row[2])}\n")
 
     conn.close()
 
@@ -6,9 +6,16 @@
 #include <sstream>
 #include <stdexcept>
 #include "omnigraph.hpp"
+#include "bucketWriterPool.hpp"
+#include "componentScheduler.hpp"
+#include "componentRuns.hpp"
+#include "runMetrics.hpp"
 #include "tuple"
 #include <sys/stat.h>
 #include <fstream>
+#include <mutex>
+#include <algorithm>
+#include <charconv>
 
 using namespace std;
 using namespace phmap;
@@ -76,39 +83,37 @@ string create_dir(string output_file, int serial) {
     return new_name;
 }
 
-const string prepare_update(int ID, int seq1_original_component, int seq2_original_component) {
-    const string _sqlite_update = "UPDATE reads SET "
-                                  "seq1_original_component=" + to_string(seq1_original_component)
-                                  + ", seq2_original_component=" + to_string(seq2_original_component)
-                                  + " WHERE ID=" + to_string(ID) + ";";
-
-    return _sqlite_update;
+// "R<ID>.1\t<comp1>\tR<ID>.2\t<comp2>\n"
+void append_pair_line(string &out, int ID, int comp1, int comp2) {
+    char line[64];
+    char *p = line, *end = line + sizeof(line);
+    char ID_buf[12];
+    char *ID_end = to_chars(ID_buf, ID_buf + sizeof(ID_buf), ID).ptr;
+
+    *p++ = 'R';
+    p = copy(ID_buf, ID_end, p);
+    p = copy_n(".1\t", 3, p);
+    p = to_chars(p, end, comp1).ptr;
+    *p++ = '\t';
+    *p++ = 'R';
+    p = copy(ID_buf, ID_end, p);
+    p = copy_n(".2\t", 3, p);
+    p = to_chars(p, end, comp2).ptr;
+    *p++ = '\n';
+    out.append(line, p - line);
 }
 
-class fileHandler {
-
-public:
-    ofstream fileStream;
-
-    fileHandler(string &filename) {
-        this->fileStream.open(filename);
-    }
-
-    void write(string &line) {
-        this->fileStream << line;
-    }
-
-    void close() {
-        fileStream.close();
-    }
-
-};
-
 int main(int argc, char **argv) {
 
     string config_file_path = "../config.ini";
     string index_prefix, PE_1_reads_file, PE_2_reads_file, sqlite_db, collective_comps_indexes_dir, fasta_out;
-    int batchSize, kSize, no_of_sequences;
+    string schedule_order;
+    int batchSize, kSize, hashing_mode, no_of_sequences, max_open_files, gzip_level, gzip_threads, scheduler_threads;
+    uint64_t memory_budget_mb;
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--config") config_file_path = argv[i + 1];
+    }
 
     INIReader reader(config_file_path);
 
@@ -124,16 +129,27 @@ int main(int argc, char **argv) {
     PE_2_reads_file = reader.Get("Reads", "read2", "");
     no_of_sequences = reader.GetInteger("Reads", "seqs_no", 0);
     sqlite_db = reader.Get("SQLite", "db_file", "query1_result.db");
+    bool write_back = reader.GetBoolean("SQLite", "write_back_components", true);
     fasta_out = reader.Get("output_fasta", "fasta_dir", "fasta_out");
     batchSize = reader.GetInteger("kProcessor", "chunk_size", 1);
     kSize = reader.GetInteger("kProcessor", "ksize", 31);
+    hashing_mode = reader.GetInteger("kProcessor", "hashing_mode", -1);
+    max_open_files = reader.GetInteger("output_fasta", "max_open_files", 512);
+    gzip_level = reader.GetInteger("output_fasta", "gzip_level", 0);
+    gzip_threads = reader.GetInteger("output_fasta", "gzip_threads", 4);
+    scheduler_threads = max(1L, reader.GetInteger("scheduler", "threads", 1));
+    memory_budget_mb = max(0L, reader.GetInteger("scheduler", "memory_budget_mb", 0));
+    schedule_order = reader.Get("scheduler", "schedule_order", "index_size");
 
     // tmp for dynamic paths on the Farm scratch
-    if (argc == 5) {
-        if ((string(argv[1]) == "--db") && (string(argv[3]) == "--out-dir")) {
-            cerr << "overriding sqlite_db_file & fasta_out" << endl;
-            sqlite_db = argv[2];
-            fasta_out = argv[4];
+    for (int i = 1; i + 1 < argc; i++) {
+        string option = argv[i];
+        if (option == "--db") {
+            cerr << "overriding sqlite_db_file" << endl;
+            sqlite_db = argv[i + 1];
+        } else if (option == "--out-dir") {
+            cerr << "overriding fasta_out" << endl;
+            fasta_out = argv[i + 1];
         }
     }
 
@@ -142,13 +158,6 @@ int main(int argc, char **argv) {
     vector<string> filenames = glob(collective_comps_indexes_dir);
     map<int, string> index_paths;
 
-    int collectiveComps_no = filenames.size();
-
-    // Create fasta files handlers, {R1,2: {comp : path}}
-    map<int, map<int, fileHandler * >> fasta_writer;
-    // Create TSV files handlers, "R1 comp R2 Comp"
-    map<int, fileHandler *> counts_writer;
-
     // create main dir
     string out_dir = create_dir(fasta_out, 0);
 
@@ -166,20 +175,7 @@ int main(int argc, char **argv) {
             {2, R2_dir}
     };
 
-    // Creating fasta files (2xCollectiveCompsNo)
-    for (int R = 1; R <= 2; R++) {
-        for (int compID = 1; compID <= collectiveComps_no; compID++) {
-            string file_name = R_dirs[R] + "/" + to_string(compID) + ".fa";
-
-            fasta_writer[R][compID] = new fileHandler(file_name);
-        }
-    }
-
-    for (int compID = 1; compID <= collectiveComps_no; compID++) {
-        string pairs_count = counts_dir + "/" + to_string(compID) + "_pairs_count.tsv";
-        counts_writer[compID] = new fileHandler(pairs_count);
-    }
-
+    blockCompressor *compressor = gzip_level > 0 ? new blockCompressor(gzip_threads, gzip_level) : nullptr;
 
     for (auto &filename : filenames) {
         string _base_name, _index_prefix;
@@ -189,63 +185,98 @@ int main(int argc, char **argv) {
         index_paths[idx_no] = _index_prefix;
     }
 
-    kDataFrame *kf;
-    Omnigraph *second_query = new Omnigraph();
-    kmerDecoder *KD = new Kmers(kSize);
-    vector<kmer_row> kmers;
-    flat_hash_map<int, flat_hash_map<int, int>> R_pairs_count;
-
-    string db_file;
     auto *SQL = new SQLiteManager(sqlite_db);
     if (!SQL->check_reads_table()) {
         cerr << "couldn't find the `reads` table." << endl;
         return 1;
     }
 
-    // Make it faster
-    string _sqlite_sync = "PRAGMA synchronous = OFF;";
-    SQL->rc = sqlite3_exec(SQL->db.db_, _sqlite_sync.c_str(), SQL->callback, 0, &SQL->zErrMsg);
-
-    map<int, string> queries = {
-            {1, "SELECT ID, PE_seq1 FROM reads WHERE seq1_collective_component="},
-            {2, "SELECT ID, PE_seq2 FROM reads WHERE seq2_collective_component="},
+    // A single sequential scan of the reads table, spilled into one run file per collective component and mate.
+    flat_hash_set<int> wanted_components;
+    for (const auto &idx : index_paths) wanted_components.insert(idx.first);
+    runMetrics metrics(reader.Get("metrics", "file", ""), reader.GetReal("metrics", "interval_sec", 0));
+    metrics.begin_stage("query_2");
+    componentRuns runs(out_dir + "/runs");
+    // Reuse the k-mer hashes query_1 persisted, if they come from the same hash function.
+    string hashes_signature = SQL->get_meta("kmer_hashes");
+    bool reuse_hashes = hashes_signature == kmerHasher::signature(kSize, hashing_mode);
+    if (!hashes_signature.empty() && !reuse_hashes) {
+        cerr << "Persisted k-mer hashes (" << hashes_signature << ") don't match ("
+             << kmerHasher::signature(kSize, hashing_mode) << "), reads will be re-hashed." << endl;
+    }
+    runs.spill(SQL, wanted_components, max_open_files, reuse_hashes);
+    fprintf(stderr, "Spilled %lu pairs into collective component runs (%.1f MB%s) in %.1fs\n",
+            (unsigned long) runs.scanned_pairs, runs.spilled_bytes / 1048576.0, reuse_hashes ? ", with k-mer hashes" : "",
+            runs.spill_sec);
+    metrics.add("scanned_pairs", runs.scanned_pairs);
+    metrics.add("spilled_bytes", runs.spilled_bytes);
+    metrics.set("spill_ms", runs.spill_sec * 1000);
+
+    // Each worker classifies a whole collective component with its own state: kmers hasher, classifier
+    // and fasta buckets. The buckets of a component are only written by its worker.
+    struct worker_state {
+        Omnigraph *classifier;
+        kmerHasher *hasher;
+        bucketWriterPool *fasta_writer;
+        decoded_read read;
+        // (row ID, original component) of the R1 / R2 mates, in row ID order
+        vector<pair<int, int>> R_comps[3];
+        string counts_buffer;
     };
 
-    const string _sqlite_update = "UPDATE reads SET "
-                                  "seq1_original_component=" + to_string(1)
-                                  + " WHERE ID=" + to_string(1) + ";";
-
-
-
-
+    vector<worker_state> workers(scheduler_threads);
+    for (auto &worker : workers) {
+        worker.classifier = new Omnigraph();
+        worker.hasher = new kmerHasher(kSize, hashing_mode);
+        // Fasta buckets keyed by (compID << 1 | R - 1), created on first write and kept within max_open_files.
+        worker.fasta_writer = new bucketWriterPool([&R_dirs](uint64_t key) {
+            return R_dirs.at((key & 1) + 1) + "/" + to_string(key >> 1) + ".fa";
+        }, max(1, max_open_files / scheduler_threads));
+        if (compressor) worker.fasta_writer->set_compressor(compressor);
+    }
 
-    // Start processing each collective component at once.
+    vector<component_task> tasks;
     for (const auto &idx : index_paths) {
-        int collectiveCompID = idx.first;
-        kf = kDataFrame::load(idx.second);
+        component_task task;
+        task.ID = idx.first;
+        task.index_prefix = idx.second;
+        task.index_bytes = componentScheduler::index_size(idx.second);
+        auto it = runs.component_reads.find(idx.first);
+        task.reads = it == runs.component_reads.end() ? 0 : it->second;
+        tasks.push_back(task);
+    }
 
-        cerr << "Processing collective component (" << collectiveCompID << ") ... ";
-        chrono::high_resolution_clock::time_point t1 = chrono::high_resolution_clock::now();
+    // Largest first, so a big component doesn't start last and leave the other workers idle.
+    stable_sort(tasks.begin(), tasks.end(), [&schedule_order](const component_task &a, const component_task &b) {
+        if (schedule_order == "reads") return a.reads > b.reads;
+        return a.index_bytes > b.index_bytes;
+    });
+
+    cerr << "Processing " << tasks.size() << " collective components on " << scheduler_threads << " threads";
+    if (memory_budget_mb) cerr << " within " << memory_budget_mb << " MB of indexes";
+    cerr << ", ordered by " << schedule_order << " ..." << endl;
+
+    // The original components are staged by the workers as they finish and written back at the end.
+    mutex log_mutex, write_back_mutex;
+    if (write_back) SQL->begin_components_update();
+    componentScheduler scheduler(tasks, scheduler_threads, memory_budget_mb);
+
+    // Start processing the collective components, each one at once on a worker.
+    scheduler.run([](component_task &task) {
+        return kDataFrame::load(task.index_prefix);
+    }, [&](component_task &task, kDataFrame *kf, int worker_id) {
+        worker_state &worker = workers[worker_id];
+        int collectiveCompID = task.ID;
+        scopedTimer component_timer(&metrics, "component_ms");
 
         // Start processing each R1 & R2 in two loops for a single collective component.
         for (int R_ID = 1; R_ID <= 2; R_ID++) {
-            const string _sqlite_select = queries[R_ID] + to_string(idx.first) + ";";
-
-            sqlite3pp::query qry(SQL->db, _sqlite_select.c_str());
+            // Iterate over the component's run, in table order
+            runs.consume(collectiveCompID, R_ID, worker.read, [&](int ROW_ID, bool hashed) {
+                if (!hashed) worker.hasher->hash_read(worker.read);
+                auto read_result = worker.classifier->classifyRead(kf, worker.read, R_ID);
 
-            // Iterate over the database reads
-            for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
-                int ROW_ID;
-                const char *PE_seq;
-
-                tie(ROW_ID, PE_seq) = (*i).get_columns < int, char const* > (0, 1);
-
-                string seq = PE_seq;
-                KD->seq_to_kmers(seq, kmers);
-                tuple<string, bool, int, uint64_t> read_result = second_query->classifyRead(kf, kmers,
-                                                                                            R_ID);
-
-                string constructedRead = get<0>(read_result);
+                string_view constructedRead = get<0>(read_result);
                 bool mapped_flag = get<1>(read_result);
                 int seq_original_component = get<3>(read_result);
 
@@ -253,87 +284,117 @@ int main(int argc, char **argv) {
                 string fasta_read = ">" + to_string(ROW_ID) + "|" + to_string(seq_original_component) + "\n";
 
                 // Read
-                fasta_read.append(constructedRead + "\n");
+                fasta_read.append(constructedRead);
+                fasta_read.append("\n");
 
                 // Write
-                fasta_writer[R_ID][collectiveCompID]->write(fasta_read);
+                worker.fasta_writer->write(((uint64_t) collectiveCompID << 1) | (R_ID - 1), fasta_read);
 
                 // Counter
-                R_pairs_count[R_ID][ROW_ID] = seq_original_component;
-
-            }
+                worker.R_comps[R_ID].emplace_back(ROW_ID, seq_original_component);
+            });
 
 
         }
 
-        // Get unique reads set for the pairwise
-        flat_hash_set<int> all_fragements;
-        for (const auto &PE : R_pairs_count) {
-            for (const auto &RID : PE.second) {
-                all_fragements.insert(RID.first);
+        // Runs are in table order, so both mates lists are sorted by row ID and merge in one pass.
+        auto &R1_comps = worker.R_comps[1], &R2_comps = worker.R_comps[2];
+        if (!is_sorted(R1_comps.begin(), R1_comps.end())) sort(R1_comps.begin(), R1_comps.end());
+        if (!is_sorted(R2_comps.begin(), R2_comps.end())) sort(R2_comps.begin(), R2_comps.end());
+
+        string &counts = worker.counts_buffer;
+        counts.clear();
+        auto it_r1 = R1_comps.begin(), it_r2 = R2_comps.begin();
+        while (it_r1 != R1_comps.end() && it_r2 != R2_comps.end()) {
+            if (it_r1->first < it_r2->first) {
+                ++it_r1;
+            } else if (it_r2->first < it_r1->first) {
+                ++it_r2;
+            } else {
+                // Pairs whose mates were both mapped, to different original components.
+                if (it_r1->second && it_r2->second && it_r1->second != it_r2->second) {
+                    append_pair_line(counts, it_r1->first, it_r1->second, it_r2->second);
+                }
+                ++it_r1;
+                ++it_r2;
             }
         }
 
-        for (const auto &fragementID : all_fragements) {
-            int read1_comp, read2_comp;
-
-            flat_hash_map<int, int>::const_iterator _it_r1 = R_pairs_count[1].find(fragementID);
-            flat_hash_map<int, int>::const_iterator _it_r2 = R_pairs_count[2].find(fragementID);
-
-            _it_r1 == R_pairs_count[1].end() ? read1_comp = 0 : read1_comp = _it_r1->second;
-            _it_r2 == R_pairs_count[2].end() ? read2_comp = 0 : read2_comp = _it_r2->second;
-
-            if (read1_comp && read2_comp) {
-                if (read1_comp != read2_comp) {
-                    string _s_fragement = to_string(fragementID);
-                    string line = "R" + _s_fragement + ".1";
-                    line.append("\t");
-                    line.append(to_string(read1_comp));
-                    line.append("\t");
-                    line.append("R" + _s_fragement + ".2");
-                    line.append("\t");
-                    line.append(to_string(read2_comp));
-                    line.append("\n");
-                    counts_writer[collectiveCompID]->write(line);
-                } else {
-                    continue;
+        if (write_back) {
+            lock_guard<mutex> lock(write_back_mutex);
+            for (int R_ID = 1; R_ID <= 2; R_ID++) {
+                for (const auto &mate : worker.R_comps[R_ID]) {
+                    if (mate.second) SQL->stage_component(R_ID, mate.first, mate.second);
                 }
-            } else {
-                continue;
             }
-
-
         }
 
-        counts_writer[collectiveCompID]->close();
-        R_pairs_count.clear();
-
-
-        chrono::high_resolution_clock::time_point t2 = chrono::high_resolution_clock::now();
-        auto milli = chrono::duration_cast<chrono::milliseconds>(t2 - t1).count();
-        long hr = milli / 3600000;
-        milli = milli - 3600000 * hr;
-        long min = milli / 60000;
-        milli = milli - 60000 * min;
-        long sec = milli / 1000;
-        milli = milli - 1000 * sec;
-        cout << " Done in " << min << ":" << sec << ":" << milli << endl;
+        // Only this component's pairs are written, in one go.
+        ofstream counts_writer(counts_dir + "/" + to_string(collectiveCompID) + "_pairs_count.tsv");
+        counts_writer.write(counts.data(), counts.size());
+        counts_writer.close();
+        R1_comps.clear();
+        R2_comps.clear();
+
+
+        double component_ms = component_timer.stop();
+        metrics.add("components");
+        metrics.add("pairs", task.reads);
+        metrics.add("pairs_count_bytes", counts.size());
+        {
+            lock_guard<mutex> lock(log_mutex);
+            cout << "Collective component (" << collectiveCompID << "), " << task.reads << " pairs, done in "
+                 << runMetrics::format_ms(component_ms) << endl;
+        }
+    });
 
-        delete kf;
+    fprintf(stderr, "Indexes loading: %.1fs, waiting for the memory budget: %.1fs\n", scheduler.load_ms / 1000,
+            scheduler.budget_wait_ms / 1000);
+    for (int w = 0; w < scheduler_threads; w++) {
+        fprintf(stderr, "Worker %d idle for %.1fs\n", w, scheduler.idle_ms[w] / 1000);
+        metrics.observe("worker_idle_ms", scheduler.idle_ms[w]);
     }
+    metrics.set("index_load_ms", scheduler.load_ms);
+    metrics.set("budget_wait_ms", scheduler.budget_wait_ms);
 
-    delete KD;
-    SQL->close();
+    if (write_back) {
+        scopedTimer timer(&metrics, "write_back_ms");
+        metrics.add("written_back_reads", SQL->end_components_update());
+    }
+    // The database destructor closes the connection.
+    delete SQL;
 
     // Closing all files
-    for (int R = 1; R <= 2; R++) {
-        for (int compID = 1; compID <= collectiveComps_no; compID++) {
-            fasta_writer[R][compID]->close();
-        }
+    uint64_t buckets = 0, opens = 0, evictions = 0;
+    double compress_wait_ms = 0;
+    ofstream compression_report;
+    if (compressor) {
+        compression_report.open(out_dir + "/compression.tsv");
+        bucketWriterPool::report_header(compression_report);
     }
-
-    for (int compID = 1; compID <= collectiveComps_no; compID++) {
-        counts_writer[compID]->close();
+    for (auto &worker : workers) {
+        worker.fasta_writer->close_all();
+        buckets += worker.fasta_writer->buckets_count();
+        opens += worker.fasta_writer->opens;
+        evictions += worker.fasta_writer->evictions;
+        compress_wait_ms += worker.fasta_writer->compress_wait_ms;
+        metrics.add("lookups", worker.classifier->lookups);
+        metrics.add("lookup_hits", worker.classifier->lookup_hits);
+        if (compressor) worker.fasta_writer->report(compression_report);
+        delete worker.fasta_writer;
+        delete worker.hasher;
+        delete worker.classifier;
+    }
+    runs.remove_dir();
+    cerr << buckets << " fasta buckets, " << opens << " opens, " << evictions << " evictions." << endl;
+    metrics.add("fasta_buckets", buckets);
+    metrics.add("bucket_opens", opens);
+    metrics.add("bucket_evictions", evictions);
+    metrics.set("compress_wait_ms", compress_wait_ms);
+    metrics.close();
+    if (compressor) {
+        compressor->print_summary(compress_wait_ms);
+        delete compressor;
     }
 
     cerr << "\nDone writing results in " << out_dir << endl;
@@ -0,0 +1,70 @@
+#include "asyncDBWriter.hpp"
+#include <chrono>
+
+asyncDBWriter::asyncDBWriter(readsStore *store, int queue_depth) {
+    this->store = store;
+    // One buffer being filled, `queue_depth` queued or being written.
+    for (int i = 0; i <= queue_depth; i++) {
+        auto *buffer = new rowsBuffer();
+        this->buffers.push_back(buffer);
+        this->free_buffers.push_back(buffer);
+    }
+    this->writer = thread(&asyncDBWriter::write_loop, this);
+}
+
+void asyncDBWriter::write_loop() {
+    while (true) {
+        rowsBuffer *buffer;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv_pending.wait(lock, [this] { return !this->pending.empty() || this->finishing; });
+            if (this->pending.empty()) return;
+            buffer = this->pending.front();
+            this->pending.pop_front();
+        }
+
+        this->store->bulk_insert(buffer->rows);
+        if (buffer->has_checkpoint) this->store->checkpoint(buffer->checkpoint);
+        this->rows_written += buffer->rows.size();
+        buffer->reset();
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->free_buffers.push_back(buffer);
+        }
+        this->cv_free.notify_one();
+    }
+}
+
+rowsBuffer *asyncDBWriter::acquire() {
+    auto t1 = chrono::high_resolution_clock::now();
+    unique_lock<mutex> lock(this->mtx);
+    this->cv_free.wait(lock, [this] { return !this->free_buffers.empty(); });
+    this->blocked_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+
+    rowsBuffer *buffer = this->free_buffers.front();
+    this->free_buffers.pop_front();
+    return buffer;
+}
+
+void asyncDBWriter::submit(rowsBuffer *buffer) {
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->pending.push_back(buffer);
+    }
+    this->cv_pending.notify_one();
+}
+
+void asyncDBWriter::finish() {
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->finishing = true;
+    }
+    this->cv_pending.notify_one();
+    if (this->writer.joinable()) this->writer.join();
+}
+
+asyncDBWriter::~asyncDBWriter() {
+    this->finish();
+    for (auto *buffer : this->buffers) delete buffer;
+}
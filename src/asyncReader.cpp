@@ -0,0 +1,121 @@
+#include "asyncReader.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+
+#define IO_ALIGNMENT 4096
+
+asyncReader::asyncReader(const string &filename, size_t readahead_mb, size_t block_mb, uint64_t start_offset) {
+    this->filename = filename;
+    this->block_size = max((size_t) 1, block_mb) << 20;
+    size_t n_blocks = max((size_t) 2, readahead_mb / max((size_t) 1, block_mb) + 1);
+
+    this->fd = open(filename.c_str(), O_RDONLY);
+    if (this->fd == -1) {
+        throw runtime_error("could not open reads file: " + filename);
+    }
+
+    unsigned char magic[2] = {0, 0};
+    this->compressed = pread(this->fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+
+    // Hint the kernel to double its readahead window for this descriptor.
+    posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    this->gz = gzdopen(this->fd, "rb");
+    gzbuffer(this->gz, 1 << 20);
+
+    if (start_offset > 0) {
+        if (gzseek(this->gz, (z_off_t) start_offset, SEEK_SET) != (z_off_t) start_offset) {
+            throw runtime_error("could not seek to " + to_string(start_offset) + " in " + filename);
+        }
+        this->read_offset = start_offset;
+    }
+
+    for (size_t i = 0; i < n_blocks; i++) {
+        block b;
+        if (posix_memalign((void **) &b.data, IO_ALIGNMENT, this->block_size) != 0) {
+            throw runtime_error("could not allocate readahead buffers");
+        }
+        this->blocks.push_back(b);
+        this->free_blocks.push_back(i);
+    }
+
+    this->producer = thread(&asyncReader::produce, this);
+}
+
+void asyncReader::produce() {
+    while (true) {
+        int idx;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv_free.wait(lock, [this] { return !this->free_blocks.empty() || this->stopped; });
+            if (this->stopped) return;
+            idx = this->free_blocks.front();
+            this->free_blocks.pop_front();
+        }
+
+        block &b = this->blocks[idx];
+        int n = gzread(this->gz, b.data, this->block_size);
+        b.offset = this->read_offset;
+        b.length = n > 0 ? n : 0;
+        this->read_offset += b.length;
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            if (n < 0) {
+                int errnum;
+                this->error_message = gzerror(this->gz, &errnum);
+            }
+            if (n <= 0) {
+                this->free_blocks.push_back(idx);
+                this->eof = true;
+            } else {
+                this->filled.push_back(idx);
+            }
+        }
+        this->cv_filled.notify_one();
+        if (n <= 0) return;
+    }
+}
+
+bool asyncReader::next_block(const char *&data, size_t &length) {
+    auto t1 = chrono::high_resolution_clock::now();
+    unique_lock<mutex> lock(this->mtx);
+
+    if (this->current_block != -1) {
+        this->free_blocks.push_back(this->current_block);
+        this->current_block = -1;
+        this->cv_free.notify_one();
+    }
+
+    this->cv_filled.wait(lock, [this] { return !this->filled.empty() || this->eof; });
+    this->io_wait_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+
+    if (!this->error_message.empty()) {
+        throw runtime_error("error reading " + this->filename + ": " + this->error_message);
+    }
+
+    if (this->filled.empty()) return false;
+
+    this->current_block = this->filled.front();
+    this->filled.pop_front();
+    data = this->blocks[this->current_block].data;
+    length = this->blocks[this->current_block].length;
+    this->block_offset = this->blocks[this->current_block].offset;
+    this->bytes_read += length;
+    return true;
+}
+
+asyncReader::~asyncReader() {
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopped = true;
+    }
+    this->cv_free.notify_all();
+    if (this->producer.joinable()) this->producer.join();
+    gzclose(this->gz);
+    for (auto &b : this->blocks) free(b.data);
+}
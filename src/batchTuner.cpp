@@ -0,0 +1,44 @@
+#include "batchTuner.hpp"
+#include <algorithm>
+#include <cmath>
+
+batchTuner::batchTuner(int initial_batch, double target_ms, size_t max_chunk_mb, const string &log_file,
+                       int min_batch, int max_batch) {
+    this->batch_size = initial_batch;
+    this->target_ms = target_ms;
+    this->memory_ceiling = max_chunk_mb << 20;
+    this->min_batch = min(min_batch, initial_batch);
+    this->max_batch = max(max_batch, initial_batch);
+
+    if (this->enabled()) {
+        this->log.open(log_file);
+        this->log << "chunk\treads\tms\tbytes\tnext_batch\n";
+    }
+}
+
+int batchTuner::update(int chunk_reads, double chunk_ms, size_t chunk_bytes) {
+    this->chunk_no++;
+    if (!this->enabled() || chunk_reads == 0) return this->batch_size;
+
+    // Smooth the per-read cost so one slow chunk (e.g. a filesystem hiccup) doesn't swing the size.
+    double current = chunk_ms / chunk_reads;
+    this->ms_per_read = (this->ms_per_read == 0) ? current : 0.7 * this->ms_per_read + 0.3 * current;
+
+    double desired = this->target_ms / max(this->ms_per_read, 1e-6);
+    desired = min(desired, 2.0 * this->batch_size);
+    desired = max(desired, 0.5 * this->batch_size);
+
+    if (this->memory_ceiling > 0 && chunk_bytes > 0) {
+        double bytes_per_read = (double) chunk_bytes / chunk_reads;
+        desired = min(desired, this->memory_ceiling / bytes_per_read);
+    }
+
+    // Round to a multiple of 1000 reads so the log stays readable.
+    int next = (int) (round(desired / 1000.0) * 1000);
+    this->batch_size = max(this->min_batch, min(this->max_batch, next));
+
+    this->log << this->chunk_no << '\t' << chunk_reads << '\t' << (long) chunk_ms << '\t' << chunk_bytes << '\t'
+              << this->batch_size << '\n';
+
+    return this->batch_size;
+}
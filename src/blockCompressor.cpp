@@ -0,0 +1,87 @@
+#include "blockCompressor.hpp"
+#include <zlib.h>
+#include <chrono>
+#include <stdexcept>
+#include <cstdio>
+
+blockCompressor::blockCompressor(int threads, int level) {
+    this->level = level;
+    for (int i = 0; i < max(1, threads); i++) {
+        this->workers.emplace_back(&blockCompressor::work_loop, this);
+    }
+}
+
+void blockCompressor::work_loop() {
+    while (true) {
+        packaged_task<compressed_block()> task;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv_tasks.wait(lock, [this] { return !this->tasks.empty() || this->stopped; });
+            if (this->tasks.empty()) return;
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+        task();
+    }
+}
+
+compressed_block blockCompressor::compress(const string &block) {
+    auto t1 = chrono::high_resolution_clock::now();
+
+    z_stream stream{};
+    // 15 + 16: zlib window with a gzip header and trailer
+    if (deflateInit2(&stream, this->level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw runtime_error("deflateInit2 failed");
+    }
+
+    string member(deflateBound(&stream, block.size()), '\0');
+    stream.next_in = (Bytef *) block.data();
+    stream.avail_in = block.size();
+    stream.next_out = (Bytef *) &member[0];
+    stream.avail_out = member.size();
+    int ret = deflate(&stream, Z_FINISH);
+    member.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        throw runtime_error("deflate failed");
+    }
+
+    auto us = (uint64_t) chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now() - t1).count();
+    this->raw_bytes += block.size();
+    this->compressed_bytes += member.size();
+    this->compress_us += us;
+    return {std::move(member), us};
+}
+
+future<compressed_block> blockCompressor::submit(string &&block) {
+    packaged_task<compressed_block()> task([this, block = std::move(block)] { return this->compress(block); });
+    auto result = task.get_future();
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->tasks.push_back(std::move(task));
+    }
+    this->cv_tasks.notify_one();
+    return result;
+}
+
+double blockCompressor::mb_per_sec() {
+    double sec = this->compress_us / 1e6;
+    return sec > 0 ? (this->raw_bytes / 1048576.0) / sec : 0;
+}
+
+void blockCompressor::print_summary(double writer_wait_ms) {
+    uint64_t raw = this->raw_bytes, compressed = this->compressed_bytes;
+    fprintf(stderr, "Compressed %.1f MB into %.1f MB (%.2fx), deflate %.1f MB/s per thread x %d threads, "
+                    "writers waited %.0fms on compression.\n",
+            raw / 1048576.0, compressed / 1048576.0, compressed ? (double) raw / compressed : 0,
+            this->mb_per_sec(), this->threads(), writer_wait_ms);
+}
+
+blockCompressor::~blockCompressor() {
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopped = true;
+    }
+    this->cv_tasks.notify_all();
+    for (auto &worker : this->workers) worker.join();
+}
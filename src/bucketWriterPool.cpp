@@ -0,0 +1,211 @@
+#include "bucketWriterPool.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+
+bucketWriterPool::bucketWriterPool(function<string(uint64_t)> bucket_path, size_t max_open_files,
+                                   size_t buffer_bytes) {
+    this->bucket_path = std::move(bucket_path);
+    this->max_open_files = max(max_open_files, (size_t) 1);
+    this->buffer_bytes = buffer_bytes;
+}
+
+void bucketWriterPool::set_compressor(blockCompressor *compressor) {
+    this->compressor = compressor;
+}
+
+string bucketWriterPool::path_of(uint64_t key) {
+    return this->bucket_path(key) + (this->compressor ? ".gz" : "");
+}
+
+void bucketWriterPool::open_bucket(uint64_t key, bucket &b) {
+    if (this->lru.size() >= this->max_open_files) {
+        uint64_t victim = this->lru.back();
+        this->close_bucket(victim, this->buckets.find(victim)->second);
+        this->evictions++;
+    }
+
+    // First open truncates leftovers of a previous run, later ones append.
+    string path = this->path_of(key);
+    int flags = O_WRONLY | O_CREAT | (b.created ? O_APPEND : O_TRUNC);
+    b.fd = open(path.c_str(), flags, 0644);
+    if (b.fd == -1) {
+        throw runtime_error("could not open bucket " + path + ": " + strerror(errno));
+    }
+    b.created = true;
+    b.buffer.reserve(this->buffer_bytes);
+    this->lru.push_front(key);
+    b.lru = this->lru.begin();
+    this->opens++;
+}
+
+void bucketWriterPool::write_out(bucket &b, const char *data, size_t length) {
+    b.stored_bytes += length;
+    this->bytes_written += length;
+    while (length) {
+        ssize_t written = ::write(b.fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("bucket write failed: ") + strerror(errno));
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+void bucketWriterPool::flush_bucket(uint64_t key, bucket &b) {
+    if (b.buffer.empty()) return;
+    b.raw_bytes += b.buffer.size();
+
+    if (this->compressor == nullptr) {
+        this->write_out(b, b.buffer.data(), b.buffer.size());
+        b.buffer.clear();
+        return;
+    }
+
+    b.pending.push_back(this->compressor->submit(std::move(b.buffer)));
+    b.buffer = string();
+    b.buffer.reserve(this->buffer_bytes);
+    this->submission_order.emplace_back(key, b.submitted++);
+    this->in_flight++;
+
+    this->drain(b, false);
+    while (this->in_flight > 4 * (size_t) this->compressor->threads()) this->wait_oldest();
+}
+
+void bucketWriterPool::drain(bucket &b, bool wait) {
+    while (!b.pending.empty()) {
+        auto &block = b.pending.front();
+        if (block.wait_for(chrono::seconds(0)) != future_status::ready) {
+            if (!wait) return;
+            auto t1 = chrono::high_resolution_clock::now();
+            block.wait();
+            this->compress_wait_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+        }
+        compressed_block compressed = block.get();
+        this->write_out(b, compressed.member.data(), compressed.member.size());
+        b.compress_us += compressed.compress_us;
+        b.pending.pop_front();
+        b.written_blocks++;
+        this->in_flight--;
+    }
+}
+
+void bucketWriterPool::wait_oldest() {
+    while (!this->submission_order.empty()) {
+        auto oldest = this->submission_order.front();
+        this->submission_order.pop_front();
+        bucket &b = this->buckets.find(oldest.first)->second;
+        // Already appended by an earlier drain
+        if (b.written_blocks > oldest.second) continue;
+        this->drain(b, true);
+        return;
+    }
+}
+
+void bucketWriterPool::close_bucket(uint64_t key, bucket &b) {
+    this->flush_bucket(key, b);
+    this->drain(b, true);
+    ::close(b.fd);
+    b.fd = -1;
+    string().swap(b.buffer);
+    this->lru.erase(b.lru);
+}
+
+void bucketWriterPool::write(uint64_t key, string_view data) {
+    auto it = this->buckets.find(key);
+    if (it == this->buckets.end()) it = this->buckets.emplace(key, bucket()).first;
+    bucket &b = it->second;
+
+    if (b.fd == -1) {
+        this->open_bucket(key, b);
+    } else if (b.lru != this->lru.begin()) {
+        this->lru.splice(this->lru.begin(), this->lru, b.lru);
+    }
+
+    b.buffer.append(data);
+    if (b.buffer.size() >= this->buffer_bytes) this->flush_bucket(key, b);
+}
+
+void bucketWriterPool::close_all() {
+    for (auto &entry : this->buckets) {
+        if (entry.second.fd != -1) this->close_bucket(entry.first, entry.second);
+    }
+    this->submission_order.clear();
+}
+
+void bucketWriterPool::report_header(ostream &out) {
+    out << "partition\traw_bytes\tgz_bytes\tratio\tcompress_ms\tMB_per_sec\n";
+}
+
+void bucketWriterPool::report(ostream &out) {
+    for (auto &entry : this->buckets) {
+        auto &b = entry.second;
+        double ratio = b.stored_bytes ? (double) b.raw_bytes / b.stored_bytes : 0;
+        double mb_per_sec = b.compress_us ? (b.raw_bytes / 1048576.0) / (b.compress_us / 1e6) : 0;
+        out << this->path_of(entry.first) << '\t' << b.raw_bytes << '\t' << b.stored_bytes << '\t' << ratio << '\t'
+            << b.compress_us / 1000.0 << '\t' << mb_per_sec << '\n';
+    }
+}
+
+bucketWriterPool::~bucketWriterPool() {
+    this->close_all();
+}
+
+// ----------------------------------------------------------------------------
+// partitionStore
+// ----------------------------------------------------------------------------
+
+partitionStore::partitionStore(const string &dir, size_t max_open_files, blockCompressor *compressor) {
+    this->dir = dir;
+    mkdir(dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    this->pool = new bucketWriterPool([dir](uint64_t comp) { return dir + "/" + to_string(comp) + ".fa"; },
+                                      max_open_files);
+    this->compressor = compressor;
+    if (compressor) this->pool->set_compressor(compressor);
+    this->load_start = chrono::high_resolution_clock::now();
+}
+
+void partitionStore::write_pair(uint64_t ID, const PE_row &row) {
+    string ID_str = to_string(ID);
+    this->record.clear();
+    this->record.append(">").append(ID_str).append(".1\n").append(row.seq1).append("\n");
+    this->record.append(">").append(ID_str).append(".2\n").append(row.seq2).append("\n");
+    // Same bucket for both mates: R1's component, R2's when R1 is unmapped.
+    this->pool->write(row.comp1 ? row.comp1 : row.comp2, this->record);
+}
+
+void partitionStore::bulk_insert(const std::pmr::vector<PE_row> &rows) {
+    for (const auto &row : rows) {
+        this->write_pair(this->next_row_id++, row);
+    }
+    this->rows_written += rows.size();
+}
+
+void partitionStore::end_bulk_load() {
+    this->pool->close_all();
+    cerr << "Partitions: " << this->rows_written << " pairs (" << (long) this->rows_per_sec() << " rows/s) in "
+         << this->pool->buckets_count() << " buckets under " << this->dir << ", " << this->pool->opens
+         << " opens, " << this->pool->evictions << " evictions." << endl;
+
+    if (this->compressor) {
+        ofstream report(this->dir + "/compression.tsv");
+        bucketWriterPool::report_header(report);
+        this->pool->report(report);
+        this->compressor->print_summary(this->pool->compress_wait_ms);
+    }
+}
+
+double partitionStore::rows_per_sec() {
+    double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - this->load_start).count();
+    return sec > 0 ? this->rows_written / sec : 0;
+}
+
+partitionStore::~partitionStore() {
+    delete this->pool;
+}
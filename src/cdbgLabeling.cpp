@@ -0,0 +1,77 @@
+#include "cdbgLabeling.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithms.hpp>
+#include <progressbar.hpp>
+
+void parse_namesFile(const string &names_fileName, flat_hash_map<uint32_t, uint32_t> &groupNameMap) {
+    ifstream namesFile(names_fileName.c_str());
+    uint32_t componentID, unitigID;
+    string line;
+    while (std::getline(namesFile, line)) {
+        std::vector<string> tokens;
+        std::istringstream iss(line);
+        std::string token;
+        while (std::getline(iss, token, '\t'))   // but we can specify a different one
+            tokens.push_back(token);
+        unitigID = std::stoi(tokens[0].substr(0, tokens[0].find(' ')));
+        componentID = std::stoi(tokens[1]);
+        groupNameMap[unitigID] = componentID;
+    }
+}
+
+kDataFrame *label_cDBG(const string &fasta_file, const string &names_tsv, int kSize, int hashing_mode,
+                       runMetrics *metrics, int chunkSize) {
+
+    runMetrics local_metrics;
+    if (!metrics) metrics = &local_metrics;
+    metrics->begin_stage("label");
+
+    flat_hash_map<uint32_t, uint32_t> unitig_to_component;
+
+    parse_namesFile(names_tsv, unitig_to_component);
+
+    auto *cDBG = new kDataFramePHMAP(kSize, hashing_mode);
+    kProcessor::kmerDecoder_setHashing(cDBG, hashing_mode);
+
+    int total_seqs = unitig_to_component.size();
+    int total_chunks = ceil((double) total_seqs / (double) chunkSize);
+
+    cerr << "total_seqs : " << total_seqs << endl;
+    cerr << "chunkSize: " << chunkSize << endl;
+    cerr << "total chunks: " << total_chunks << endl;
+
+    progressbar bar(total_chunks);
+    bar.set_done_char("█");
+
+    kmerDecoder *KD = new Kmers(fasta_file, chunkSize, kSize);
+    KD->setHashingMode(hashing_mode);
+    int original_inserted_kmers = 0;
+    while (!KD->end()) {
+        scopedTimer chunk_timer(metrics, "chunk_ms");
+        KD->next_chunk();
+        bar.update();
+        metrics->add("unitigs", KD->getKmers()->size());
+        for (const auto &seq : *KD->getKmers()) {
+            uint32_t unitig_id = std::stoi(seq.first.substr(0, seq.first.find(' ')));
+            uint32_t component = unitig_to_component[unitig_id];
+            for (const auto &kmer : seq.second) {
+                original_inserted_kmers++;
+                cDBG->setCount(kmer.hash, component);
+            }
+        }
+    }
+    delete KD;
+    metrics->add("kmers", original_inserted_kmers);
+    metrics->set("index_kmers", (double) cDBG->size());
+    metrics->end_stage();
+    cout << endl << endl;
+
+    cout << "number of lost kmers: original(" << original_inserted_kmers << ") - inserted(" << cDBG->size()
+         << ") = "
+         << original_inserted_kmers - cDBG->size() << endl;
+
+    return cDBG;
+}
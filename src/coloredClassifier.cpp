@@ -0,0 +1,81 @@
+#include "coloredClassifier.hpp"
+#include <algorithm>
+
+coloredClassifier::coloredClassifier(colored_kDataFrame *ckf, mutex *index_mutex, size_t n_sources) {
+    this->ckf = ckf;
+    this->kf = ckf->getkDataFrame();
+    this->index_mutex = index_mutex;
+    this->votes.assign(n_sources, 0);
+}
+
+const vector<uint32_t> &coloredClassifier::sources_of(uint64_t color) {
+    auto it = this->color_sources.find(color);
+    if (it != this->color_sources.end()) return it->second;
+
+    vector<uint32_t> sources;
+    {
+        lock_guard<mutex> lock(*this->index_mutex);
+        this->ckf->getKmerSourceFromColor(color, sources);
+    }
+    sort(sources.begin(), sources.end());
+    sources.erase(unique(sources.begin(), sources.end()), sources.end());
+    this->cache_misses++;
+    return this->color_sources[color] = std::move(sources);
+}
+
+void coloredClassifier::classify(const decoded_read &read, colored_result &result) {
+    result.kmers = 0;
+    result.matched_kmers = 0;
+    result.best_source = UINT32_MAX;
+    result.best_votes = 0;
+    result.intersection.clear();
+    bool first_color = true;
+
+    // Runs of k-mers with the same color vote once, weighted by their length.
+    uint64_t run_color = 0;
+    uint32_t run_length = 0;
+    auto close_run = [&]() {
+        if (run_length == 0) return;
+        const vector<uint32_t> &sources = this->sources_of(run_color);
+
+        for (uint32_t source : sources) {
+            if (source >= this->votes.size()) this->votes.resize(source + 1, 0);
+            if (this->votes[source] == 0) this->voted_sources.push_back(source);
+            this->votes[source] += run_length;
+        }
+
+        if (first_color) {
+            result.intersection.assign(sources.begin(), sources.end());
+            first_color = false;
+        } else if (!result.intersection.empty()) {
+            this->intersection_buffer.clear();
+            set_intersection(result.intersection.begin(), result.intersection.end(), sources.begin(), sources.end(),
+                             back_inserter(this->intersection_buffer));
+            result.intersection.swap(this->intersection_buffer);
+        }
+        run_length = 0;
+    };
+
+    for (uint64_t hash : read.hashes) {
+        if (hash == MASKED_KMER) continue;
+        result.kmers++;
+        uint64_t color = hash == INVALID_KMER ? 0 : this->kf->getCount(hash);
+        if (color == 0) continue;
+        result.matched_kmers++;
+        if (run_length && color != run_color) close_run();
+        run_color = color;
+        run_length++;
+    }
+    close_run();
+
+    // Ties go to the smallest source ID.
+    for (uint32_t source : this->voted_sources) {
+        uint32_t count = this->votes[source];
+        if (count > result.best_votes || (count == result.best_votes && source < result.best_source)) {
+            result.best_votes = count;
+            result.best_source = source;
+        }
+        this->votes[source] = 0;
+    }
+    this->voted_sources.clear();
+}
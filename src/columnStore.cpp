@@ -0,0 +1,228 @@
+#include "columnStore.hpp"
+#include "seqEncoder.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+template<class T>
+static void write_array(ofstream &out, const vector<T> &values, size_t n) {
+    out.write((const char *) values.data(), n * sizeof(T));
+}
+
+columnStore::columnStore(const string &dir) {
+    this->dir = dir;
+    mkdir(dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    this->segments.open(dir + "/segments.bin", ios::binary | ios::trunc);
+    if (!this->segments.is_open()) {
+        throw runtime_error("could not create the column store in " + dir);
+    }
+    this->load_start = chrono::high_resolution_clock::now();
+}
+
+void columnStore::bulk_insert(const std::pmr::vector<PE_row> &rows) {
+    size_t n = rows.size();
+    if (n == 0) return;
+
+    this->comp1.resize(n);
+    this->comp2.resize(n);
+    this->seq_sizes.resize(2 * n);
+    this->components.clear();
+
+    // Sized for the worst case, so every sequence is encoded once, only the packed bytes are written.
+    size_t max_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        this->comp1[i] = rows[i].comp1;
+        this->comp2[i] = rows[i].comp2;
+        max_bytes += seqEncoder::max_packed_size(rows[i].seq1.size()) + seqEncoder::max_packed_size(rows[i].seq2.size());
+        if (rows[i].comp1) this->components.push_back(rows[i].comp1);
+        if (rows[i].comp2) this->components.push_back(rows[i].comp2);
+    }
+
+    if (this->seqs.size() < max_bytes) this->seqs.resize(max_bytes);
+    size_t seq_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        this->seq_sizes[2 * i] = seqEncoder::pack(rows[i].seq1.data(), rows[i].seq1.size(), this->seqs.data() + seq_bytes);
+        seq_bytes += this->seq_sizes[2 * i];
+        this->seq_sizes[2 * i + 1] = seqEncoder::pack(rows[i].seq2.data(), rows[i].seq2.size(), this->seqs.data() + seq_bytes);
+        seq_bytes += this->seq_sizes[2 * i + 1];
+    }
+
+    sort(this->components.begin(), this->components.end());
+    this->components.erase(unique(this->components.begin(), this->components.end()), this->components.end());
+
+    segment_header header{};
+    header.magic = COLUMNSTORE_SEGMENT_MAGIC;
+    header.n_rows = n;
+    header.first_row_id = this->next_row_id;
+    header.min_comp = this->components.empty() ? 0 : this->components.front();
+    header.max_comp = this->components.empty() ? 0 : this->components.back();
+    header.n_components = this->components.size();
+    header.seq_bytes = seq_bytes;
+
+    auto segment_id = (uint32_t) this->segment_offsets.size();
+    this->segment_offsets.push_back(this->offset);
+    this->segment_rows.push_back(n);
+    for (auto &comp : this->components) this->component_segments[comp].push_back(segment_id);
+
+    this->segments.write((const char *) &header, sizeof(header));
+    write_array(this->segments, this->components, this->components.size());
+    write_array(this->segments, this->comp1, n);
+    write_array(this->segments, this->comp2, n);
+    write_array(this->segments, this->seq_sizes, 2 * n);
+    write_array(this->segments, this->seqs, seq_bytes);
+
+    this->offset += sizeof(header) + (this->components.size() + 4 * n) * sizeof(uint32_t) + seq_bytes;
+    this->next_row_id += n;
+    this->rows_written += n;
+}
+
+void columnStore::end_bulk_load() {
+    this->segments.close();
+
+    ofstream index(this->dir + "/index.bin", ios::binary | ios::trunc);
+    uint64_t n_segments = this->segment_offsets.size();
+    index.write((const char *) &n_segments, sizeof(n_segments));
+    write_array(index, this->segment_offsets, n_segments);
+    write_array(index, this->segment_rows, n_segments);
+
+    // Components sorted so the index is reproducible between runs.
+    vector<uint32_t> comps;
+    comps.reserve(this->component_segments.size());
+    for (auto &entry : this->component_segments) comps.push_back(entry.first);
+    sort(comps.begin(), comps.end());
+
+    uint64_t n_components = comps.size();
+    index.write((const char *) &n_components, sizeof(n_components));
+    for (auto &comp : comps) {
+        auto &segment_ids = this->component_segments[comp];
+        auto count = (uint32_t) segment_ids.size();
+        index.write((const char *) &comp, sizeof(comp));
+        index.write((const char *) &count, sizeof(count));
+        write_array(index, segment_ids, count);
+    }
+    index.close();
+
+    cerr << "Column store: " << this->rows_written << " rows in " << n_segments << " segments ("
+         << (long) this->rows_per_sec() << " rows/s), " << n_components << " components indexed." << endl;
+}
+
+double columnStore::rows_per_sec() {
+    double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - this->load_start).count();
+    return sec > 0 ? this->rows_written / sec : 0;
+}
+
+// ----------------------------------------------------------------------------
+// columnStoreReader
+// ----------------------------------------------------------------------------
+
+template<class T>
+static void read_array(ifstream &in, vector<T> &values, size_t n) {
+    values.resize(n);
+    in.read((char *) values.data(), n * sizeof(T));
+}
+
+template<class T>
+static void pread_array(int fd, vector<T> &values, size_t n, uint64_t &offset) {
+    values.resize(n);
+    size_t bytes = n * sizeof(T), done = 0;
+    while (done < bytes) {
+        ssize_t got = pread(fd, (char *) values.data() + done, bytes - done, offset + done);
+        if (got <= 0) throw runtime_error("truncated column store segment");
+        done += got;
+    }
+    offset += bytes;
+}
+
+columnStoreReader::columnStoreReader(const string &dir) {
+    this->dir = dir;
+    ifstream index(dir + "/index.bin", ios::binary);
+    if (!index.is_open()) {
+        throw runtime_error("could not open the column store index in " + dir);
+    }
+
+    uint64_t n_segments, n_components;
+    index.read((char *) &n_segments, sizeof(n_segments));
+    read_array(index, this->segment_offsets, n_segments);
+    read_array(index, this->segment_rows, n_segments);
+    index.read((char *) &n_components, sizeof(n_components));
+    for (uint64_t i = 0; i < n_components; i++) {
+        uint32_t comp, count;
+        index.read((char *) &comp, sizeof(comp));
+        index.read((char *) &count, sizeof(count));
+        read_array(index, this->component_segments[comp], count);
+    }
+
+    this->fd = open((dir + "/segments.bin").c_str(), O_RDONLY);
+    if (this->fd == -1) {
+        throw runtime_error("could not open the column store segments in " + dir);
+    }
+    posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+vector<uint32_t> columnStoreReader::segments_for(const vector<uint32_t> &components) {
+    vector<uint32_t> segment_ids;
+    for (auto &comp : components) {
+        auto it = this->component_segments.find(comp);
+        if (it == this->component_segments.end()) continue;
+        segment_ids.insert(segment_ids.end(), it->second.begin(), it->second.end());
+    }
+    sort(segment_ids.begin(), segment_ids.end());
+    segment_ids.erase(unique(segment_ids.begin(), segment_ids.end()), segment_ids.end());
+    return segment_ids;
+}
+
+void columnStoreReader::scan(const vector<uint32_t> &segment_ids, const function<void(column_row &)> &callback) {
+    vector<uint32_t> components, comp1, comp2, seq_sizes;
+    vector<uint8_t> seqs;
+    column_row row;
+
+    for (auto &segment_id : segment_ids) {
+        uint64_t offset = this->segment_offsets[segment_id];
+        vector<segment_header> header;
+        pread_array(this->fd, header, 1, offset);
+        if (header[0].magic != COLUMNSTORE_SEGMENT_MAGIC) {
+            throw runtime_error("corrupted column store segment " + to_string(segment_id));
+        }
+
+        size_t n = header[0].n_rows;
+        pread_array(this->fd, components, header[0].n_components, offset);
+        pread_array(this->fd, comp1, n, offset);
+        pread_array(this->fd, comp2, n, offset);
+        pread_array(this->fd, seq_sizes, 2 * n, offset);
+        pread_array(this->fd, seqs, header[0].seq_bytes, offset);
+        uint64_t sizes_total = 0;
+        for (auto &seq_size : seq_sizes) sizes_total += seq_size;
+        if (sizes_total != seqs.size()) {
+            throw runtime_error("corrupted column store segment " + to_string(segment_id));
+        }
+
+        const uint8_t *p = seqs.data();
+        for (size_t i = 0; i < n; i++) {
+            row.ID = header[0].first_row_id + i;
+            row.comp1 = comp1[i];
+            row.comp2 = comp2[i];
+            bool valid = seqEncoder::unpack(p, seq_sizes[2 * i], row.seq1);
+            p += seq_sizes[2 * i];
+            valid = seqEncoder::unpack(p, seq_sizes[2 * i + 1], row.seq2) && valid;
+            p += seq_sizes[2 * i + 1];
+            if (!valid) {
+                cerr << "malformed packed sequence in row " << row.ID << ", skipped" << endl;
+                continue;
+            }
+            callback(row);
+        }
+    }
+}
+
+void columnStoreReader::scan_all(const function<void(column_row &)> &callback) {
+    vector<uint32_t> segment_ids(this->segment_offsets.size());
+    for (size_t i = 0; i < segment_ids.size(); i++) segment_ids[i] = i;
+    this->scan(segment_ids, callback);
+}
+
+columnStoreReader::~columnStoreReader() {
+    if (this->fd != -1) close(this->fd);
+}
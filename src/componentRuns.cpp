@@ -0,0 +1,87 @@
+#include "componentRuns.hpp"
+#include "bucketWriterPool.hpp"
+#include "sqlite3pp.h"
+#include <fstream>
+#include <chrono>
+#include <unistd.h>
+#include <sys/stat.h>
+
+componentRuns::componentRuns(const string &dir) {
+    this->dir = dir;
+    mkdir(dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+}
+
+string componentRuns::path(int comp, int R_ID) const {
+    return this->dir + "/" + to_string(comp) + "." + to_string(R_ID) + ".run";
+}
+
+void componentRuns::spill(SQLiteManager *SQL, const flat_hash_set<int> &wanted, size_t max_open_files,
+                          bool with_hashes) {
+    auto t1 = chrono::high_resolution_clock::now();
+
+    // Runs keyed by (comp << 1 | R - 1)
+    bucketWriterPool runs([this](uint64_t key) {
+        return this->path((int) (key >> 1), (int) (key & 1) + 1);
+    }, max_open_files);
+
+    string seq, record;
+    vector<uint64_t> hashes;
+    auto spill_mate = [&](const sqlite3pp::query::rows &row, int comp, int R_ID, uint32_t ID) -> bool {
+        if (!SQLiteManager::read_seq(row, R_ID, seq)) {
+            fprintf(stderr, "malformed packed sequence in read %u.%d, skipped\n", ID, R_ID);
+            return false;
+        }
+        if (!with_hashes || !SQLiteManager::read_hashes(row, 4 + R_ID, hashes)) hashes.clear();
+        uint32_t header[3] = {ID, (uint32_t) seq.size(), (uint32_t) hashes.size()};
+        record.assign((const char *) header, sizeof(header));
+        record.append(seq);
+        record.append((const char *) hashes.data(), hashes.size() * sizeof(uint64_t));
+        runs.write(((uint64_t) comp << 1) | (R_ID - 1), record);
+        return true;
+    };
+
+    string _sqlite_select = "SELECT ID, PE_seq1, PE_seq2, seq1_collective_component, seq2_collective_component";
+    _sqlite_select += with_hashes ? ", seq1_hashes, seq2_hashes FROM reads;" : " FROM reads;";
+    sqlite3pp::query qry(SQL->db, _sqlite_select.c_str());
+    for (auto row : qry) {
+        this->scanned_pairs++;
+        auto ID = (uint32_t) row.get<long long>(0);
+        int comp1 = row.get<int>(3), comp2 = row.get<int>(4);
+        if (wanted.count(comp1) && spill_mate(row, comp1, 1, ID)) {
+            this->component_reads[comp1]++;
+        }
+        if (wanted.count(comp2)) spill_mate(row, comp2, 2, ID);
+    }
+
+    runs.close_all();
+    this->spilled_bytes = runs.bytes_written;
+    this->spill_sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+}
+
+bool componentRuns::consume(int comp, int R_ID, decoded_read &read, const function<void(int ID, bool hashed)> &f) const {
+    string run_path = this->path(comp, R_ID);
+    ifstream run(run_path, ios::binary);
+    if (!run.is_open()) return false;
+
+    vector<char> buffer(1 << 20);
+    run.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+    uint32_t header[3];
+    while (run.read((char *) header, sizeof(header))) {
+        read.seq.resize(header[1]);
+        read.hashes.resize(header[2]);
+        if (!run.read(&read.seq[0], header[1]) ||
+            !run.read((char *) read.hashes.data(), header[2] * sizeof(uint64_t))) {
+            fprintf(stderr, "truncated run file %s\n", run_path.c_str());
+            break;
+        }
+        f((int) header[0], header[2] > 0);
+    }
+    run.close();
+    unlink(run_path.c_str());
+    return true;
+}
+
+void componentRuns::remove_dir() const {
+    rmdir(this->dir.c_str());
+}
@@ -0,0 +1,92 @@
+#include "componentScheduler.hpp"
+#include <glob.h>
+#include <sys/stat.h>
+#include <chrono>
+
+componentScheduler::componentScheduler(vector<component_task> tasks, int workers, uint64_t budget_mb) {
+    this->tasks = std::move(tasks);
+    this->workers = max(1, workers);
+    this->budget_bytes = budget_mb << 20;
+    this->idle_ms.assign(this->workers, 0);
+}
+
+uint64_t componentScheduler::index_size(const string &index_prefix) {
+    glob_t glob_result{};
+    uint64_t total = 0;
+    if (glob((index_prefix + "*").c_str(), 0, nullptr, &glob_result) == 0) {
+        for (size_t i = 0; i < glob_result.gl_pathc; i++) {
+            struct stat st{};
+            if (stat(glob_result.gl_pathv[i], &st) == 0 && S_ISREG(st.st_mode)) total += st.st_size;
+        }
+    }
+    globfree(&glob_result);
+    return total;
+}
+
+void componentScheduler::load_loop(const function<kDataFrame *(component_task &)> &load) {
+    for (auto &task : this->tasks) {
+        {
+            auto t1 = chrono::high_resolution_clock::now();
+            unique_lock<mutex> lock(this->mtx);
+            this->cv_budget.wait(lock, [this, &task] {
+                if (this->budget_bytes == 0) return this->loaded.size() < (size_t) this->workers;
+                return this->resident_bytes == 0 || this->resident_bytes + task.index_bytes <= this->budget_bytes;
+            });
+            this->resident_bytes += task.index_bytes;
+            this->budget_wait_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+        }
+
+        auto t1 = chrono::high_resolution_clock::now();
+        kDataFrame *kf = load(task);
+        this->load_ms += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->loaded.emplace_back(&task, kf);
+        }
+        this->cv_loaded.notify_one();
+    }
+
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->loading_done = true;
+    }
+    this->cv_loaded.notify_all();
+}
+
+void componentScheduler::work_loop(int worker_id, const function<void(component_task &, kDataFrame *, int)> &process) {
+    while (true) {
+        pair<component_task *, kDataFrame *> next;
+        {
+            auto t1 = chrono::high_resolution_clock::now();
+            unique_lock<mutex> lock(this->mtx);
+            this->cv_loaded.wait(lock, [this] { return !this->loaded.empty() || this->loading_done; });
+            this->idle_ms[worker_id] += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+            if (this->loaded.empty()) return;
+            next = this->loaded.front();
+            this->loaded.pop_front();
+        }
+        // Room for one more prefetch when there's no budget.
+        this->cv_budget.notify_one();
+
+        process(*next.first, next.second, worker_id);
+        delete next.second;
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->resident_bytes -= next.first->index_bytes;
+        }
+        this->cv_budget.notify_one();
+    }
+}
+
+void componentScheduler::run(const function<kDataFrame *(component_task &)> &load,
+                             const function<void(component_task &, kDataFrame *, int)> &process) {
+    thread loader(&componentScheduler::load_loop, this, cref(load));
+    vector<thread> worker_threads;
+    for (int w = 0; w < this->workers; w++) {
+        worker_threads.emplace_back(&componentScheduler::work_loop, this, w, cref(process));
+    }
+    loader.join();
+    for (auto &worker : worker_threads) worker.join();
+}
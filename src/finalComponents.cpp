@@ -0,0 +1,172 @@
+#include "finalComponents.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+finalComponents::finalComponents(uint32_t n_original, uint32_t cutoff) {
+    this->cutoff = cutoff;
+    this->grow(n_original);
+}
+
+void finalComponents::grow(uint32_t comp) {
+    if (comp < this->parent.size()) return;
+    size_t old_size = this->parent.size();
+    this->parent.resize(comp + 1);
+    this->rank.resize(comp + 1, 0);
+    this->linked.resize(comp + 1, false);
+    this->original_reads.resize(comp + 1, 0);
+    for (size_t i = old_size; i <= comp; i++) this->parent[i] = i;
+}
+
+uint32_t finalComponents::find(uint32_t x) {
+    uint32_t root = x;
+    while (this->parent[root] != root) root = this->parent[root];
+    while (this->parent[x] != root) {
+        uint32_t next = this->parent[x];
+        this->parent[x] = root;
+        x = next;
+    }
+    return root;
+}
+
+void finalComponents::add_edge(uint32_t comp1, uint32_t comp2) {
+    if (comp1 == 0 || comp2 == 0) return;
+    this->grow(max(comp1, comp2));
+    this->linked[comp1] = this->linked[comp2] = true;
+    this->edges_used++;
+
+    uint32_t root1 = this->find(comp1), root2 = this->find(comp2);
+    if (root1 == root2) return;
+    if (this->rank[root1] < this->rank[root2]) swap(root1, root2);
+    this->parent[root2] = root1;
+    if (this->rank[root1] == this->rank[root2]) this->rank[root1]++;
+}
+
+void finalComponents::add_pairs_count(uint32_t comp1, uint32_t comp2, uint32_t count) {
+    if (count >= this->cutoff) {
+        this->add_edge(comp1, comp2);
+    } else {
+        this->edges_filtered++;
+    }
+}
+
+void finalComponents::add_reads(uint32_t comp, uint64_t reads) {
+    if (comp == 0) return;
+    this->grow(comp);
+    this->original_reads[comp] += reads;
+}
+
+void finalComponents::load_pairs_count(const string &tsv_file) {
+    ifstream tsv(tsv_file);
+    if (!tsv.is_open()) {
+        throw runtime_error("could not open pairs count file " + tsv_file);
+    }
+
+    string line;
+    getline(tsv, line); // header
+    uint32_t comp1, comp2, count;
+    while (tsv >> comp1 >> comp2 >> count) this->add_pairs_count(comp1, comp2, count);
+}
+
+void finalComponents::construct() {
+    this->final_of.assign(this->parent.size(), 0);
+    this->n_final = 0;
+
+    // Ascending scan: each group is numbered when its smallest member is met.
+    for (uint32_t comp = 1; comp < this->parent.size(); comp++) {
+        if (!this->linked[comp]) continue;
+        uint32_t root = this->find(comp);
+        if (this->final_of[root] == 0) this->final_of[root] = ++this->n_final;
+        this->final_of[comp] = this->final_of[root];
+    }
+    this->n_connected = this->n_final;
+
+    for (uint32_t comp = 1; comp < this->parent.size(); comp++) {
+        if (!this->linked[comp]) this->final_of[comp] = ++this->n_final;
+    }
+
+    this->final_originals.assign(this->n_final + 1, 0);
+    this->final_reads.assign(this->n_final + 1, 0);
+    for (uint32_t comp = 1; comp < this->final_of.size(); comp++) {
+        this->final_originals[this->final_of[comp]]++;
+        this->final_reads[this->final_of[comp]] += this->original_reads[comp];
+    }
+}
+
+void finalComponents::tsv_export(const string &file_name) {
+    vector<vector<uint32_t>> members(this->n_final + 1);
+    for (uint32_t comp = 1; comp < this->final_of.size(); comp++) {
+        if (this->final_of[comp]) members[this->final_of[comp]].push_back(comp);
+    }
+
+    ofstream tsv(file_name);
+    string line;
+    for (uint32_t final_comp = 1; final_comp <= this->n_final; final_comp++) {
+        line = to_string(final_comp) + '\t';
+        for (size_t i = 0; i < members[final_comp].size(); i++) {
+            if (i) line += ',';
+            line += to_string(members[final_comp][i]);
+        }
+        line += '\n';
+        tsv << line;
+    }
+}
+
+void finalComponents::sizes_tsv_export(const string &file_name) {
+    ofstream tsv(file_name);
+    tsv << "final_component\toriginal_components\treads\n";
+    for (uint32_t final_comp = 1; final_comp <= this->n_final; final_comp++) {
+        tsv << final_comp << '\t' << this->final_originals[final_comp] << '\t' << this->final_reads[final_comp] << '\n';
+    }
+}
+
+void finalComponents::binary_export(const string &file_name) {
+    ofstream out(file_name, ios::binary | ios::trunc);
+    final_components_header header{FINAL_COMPONENTS_MAGIC, (uint32_t) this->final_of.size() - 1, this->n_final,
+                                   this->n_connected, this->cutoff};
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) this->final_of.data(), this->final_of.size() * sizeof(uint32_t));
+    for (uint32_t final_comp = 1; final_comp <= this->n_final; final_comp++) {
+        out.write((const char *) &this->final_originals[final_comp], sizeof(uint32_t));
+        out.write((const char *) &this->final_reads[final_comp], sizeof(uint64_t));
+    }
+}
+
+void finalComponents::binary_import(const string &file_name) {
+    ifstream in(file_name, ios::binary);
+    final_components_header header{};
+    in.read((char *) &header, sizeof(header));
+    if (!in || header.magic != FINAL_COMPONENTS_MAGIC) {
+        throw runtime_error(file_name + " is not a final components map");
+    }
+
+    this->final_of.resize(header.n_original + 1);
+    in.read((char *) this->final_of.data(), this->final_of.size() * sizeof(uint32_t));
+    this->n_final = header.n_final;
+    this->n_connected = header.n_connected;
+    this->cutoff = header.cutoff;
+    this->final_originals.assign(this->n_final + 1, 0);
+    this->final_reads.assign(this->n_final + 1, 0);
+    for (uint32_t final_comp = 1; final_comp <= this->n_final; final_comp++) {
+        in.read((char *) &this->final_originals[final_comp], sizeof(uint32_t));
+        in.read((char *) &this->final_reads[final_comp], sizeof(uint64_t));
+    }
+    if (!in) {
+        throw runtime_error("truncated final components map " + file_name);
+    }
+}
+
+uint32_t finalComponents::count_original_components(const string &csv_file) {
+    ifstream csv(csv_file);
+    if (!csv.is_open()) {
+        throw runtime_error("could not open original components file " + csv_file);
+    }
+
+    uint32_t max_comp = 0;
+    string line;
+    while (getline(csv, line)) {
+        if (line.empty()) continue;
+        max_comp = max(max_comp, (uint32_t) stoul(line.substr(0, line.find(','))));
+    }
+    return max_comp;
+}
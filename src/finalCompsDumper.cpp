@@ -0,0 +1,211 @@
+#include "finalCompsDumper.hpp"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "sqliteManager.hpp"
+#include "columnStore.hpp"
+#include "partitionManifest.hpp"
+#include "bucketWriterPool.hpp"
+#include "runMetrics.hpp"
+
+struct final_pair {
+    uint64_t ID;
+    uint32_t comp1, comp2, final_comp;
+    uint64_t offset1, offset2;
+    string seq1, seq2;
+};
+
+enum class reads_source { sqlite, columnar, manifest };
+
+static reads_source detect_source(const string &path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return reads_source::columnar;
+    if (path.size() >= 9 && path.compare(path.size() - 9, 9, ".manifest") == 0) return reads_source::manifest;
+    return reads_source::sqlite;
+}
+
+uint64_t dump_final_components(const string &reads_path, finalComponents &components, const dump_options &options) {
+
+    const string &out_dir = options.out_dir;
+    int threads = max(1, options.threads);
+    auto t1 = chrono::high_resolution_clock::now();
+    runMetrics local_metrics;
+    runMetrics *metrics = options.metrics ? options.metrics : &local_metrics;
+    metrics->begin_stage("dump");
+
+    if (mkdir(out_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) == -1) {
+        throw runtime_error("could not create " + out_dir + ", does it already exist?");
+    }
+    components.tsv_export(out_dir + "/finalComponents.tsv");
+
+    // --------------------------------------------------------------------------------
+    //                                Partition writers                               |
+    // --------------------------------------------------------------------------------
+
+    reads_source source = detect_source(reads_path);
+    manifestReader *manifest = nullptr;
+    int R1_fd = -1, R2_fd = -1;
+    if (source == reads_source::manifest) {
+        manifest = new manifestReader(reads_path);
+        R1_fd = open(manifest->R1_file.c_str(), O_RDONLY);
+        R2_fd = open(manifest->R2_file.c_str(), O_RDONLY);
+        if (R1_fd == -1 || R2_fd == -1) {
+            throw runtime_error("could not open the reads files referenced by the manifest.");
+        }
+    }
+
+    blockCompressor *compressor = options.gzip_level > 0
+                                  ? new blockCompressor(options.gzip_threads, options.gzip_level) : nullptr;
+    vector<bucketWriterPool *> pools(threads);
+    for (auto &pool : pools) {
+        pool = new bucketWriterPool([&out_dir](uint64_t comp) { return out_dir + "/" + to_string(comp) + ".fa"; },
+                                    max(1, options.max_open_files / threads));
+        if (compressor) pool->set_compressor(compressor);
+    }
+
+    size_t batch_size = 200000, batch_pairs = 0;
+    vector<final_pair> batch(batch_size);
+    uint64_t scanned_pairs = 0, written_pairs = 0, written_bytes = 0, reported_scanned = 0;
+
+    auto write_batch = [&]() {
+        scopedTimer batch_timer(metrics, "batch_ms");
+#pragma omp parallel num_threads(threads)
+        {
+            auto thread_id = (uint32_t) omp_get_thread_num();
+            bucketWriterPool *pool = pools[thread_id];
+            vector<char> window(manifest ? manifestReader::initial_window : 0);
+            string record;
+            uint64_t thread_bytes = 0;
+
+            for (size_t i = 0; i < batch_pairs; i++) {
+                final_pair &pair = batch[i];
+                if (pair.final_comp % (uint32_t) threads != thread_id) continue;
+                if (manifest) {
+                    manifestReader::read_sequence(R1_fd, pair.offset1, window, pair.seq1);
+                    manifestReader::read_sequence(R2_fd, pair.offset2, window, pair.seq2);
+                }
+                string ID = to_string(pair.ID);
+                record.clear();
+                record.append(">").append(ID).append(".1\t").append(to_string(pair.comp1)).append("\n");
+                record.append(pair.seq1).append("\n");
+                record.append(">").append(ID).append(".2\t").append(to_string(pair.comp2)).append("\n");
+                record.append(pair.seq2).append("\n");
+                pool->write(pair.final_comp, record);
+                thread_bytes += record.size();
+            }
+#pragma omp atomic
+            written_bytes += thread_bytes;
+        }
+        written_pairs += batch_pairs;
+        metrics->add("written_pairs", batch_pairs);
+        metrics->add("scanned_pairs", scanned_pairs - reported_scanned);
+        reported_scanned = scanned_pairs;
+        batch_pairs = 0;
+    };
+
+    // Final component of a pair, 0 when it's unmapped or spans two final components.
+    auto route = [&components](uint32_t comp1, uint32_t comp2) -> uint32_t {
+        uint32_t final1 = components.get(comp1), final2 = components.get(comp2);
+        if (final1 && final2) return final1 == final2 ? final1 : 0;
+        return final1 ? final1 : final2;
+    };
+
+    auto next_slot = [&](uint64_t ID, uint32_t comp1, uint32_t comp2, uint32_t final_comp) -> final_pair & {
+        final_pair &pair = batch[batch_pairs++];
+        pair.ID = ID;
+        pair.comp1 = comp1;
+        pair.comp2 = comp2;
+        pair.final_comp = final_comp;
+        return pair;
+    };
+
+    // --------------------------------------------------------------------------------
+    //                              Single scan of the reads                          |
+    // --------------------------------------------------------------------------------
+
+    if (source == reads_source::sqlite) {
+        SQLiteManager SQL(reads_path);
+        if (!SQL.check_reads_table()) {
+            throw runtime_error("couldn't find the `reads` table in " + reads_path);
+        }
+        sqlite3pp::query qry(SQL.db, "SELECT ID, PE_seq1, PE_seq2, seq1_original_component, "
+                                      "seq2_original_component FROM reads;");
+        for (auto row : qry) {
+            scanned_pairs++;
+            auto comp1 = (uint32_t) row.get<long long>(3), comp2 = (uint32_t) row.get<long long>(4);
+            uint32_t final_comp = route(comp1, comp2);
+            if (!final_comp) continue;
+            final_pair &pair = next_slot(row.get<long long>(0), comp1, comp2, final_comp);
+            if (!SQLiteManager::read_seq(row, 1, pair.seq1) || !SQLiteManager::read_seq(row, 2, pair.seq2)) {
+                fprintf(stderr, "malformed packed sequence in pair %lld, skipped\n", row.get<long long>(0));
+                batch_pairs--;
+                continue;
+            }
+            if (batch_pairs == batch_size) write_batch();
+        }
+    } else if (source == reads_source::columnar) {
+        columnStoreReader store(reads_path);
+        store.scan_all([&](column_row &row) {
+            scanned_pairs++;
+            uint32_t final_comp = route(row.comp1, row.comp2);
+            if (!final_comp) return;
+            final_pair &pair = next_slot(row.ID, row.comp1, row.comp2, final_comp);
+            pair.seq1.swap(row.seq1);
+            pair.seq2.swap(row.seq2);
+            if (batch_pairs == batch_size) write_batch();
+        });
+    } else {
+        for (uint64_t i = 0; i < manifest->n_pairs; i++) {
+            const manifest_record &record = manifest->records[i];
+            scanned_pairs++;
+            uint32_t final_comp = route(record.comp1, record.comp2);
+            if (!final_comp) continue;
+            final_pair &pair = next_slot(i + 1, record.comp1, record.comp2, final_comp);
+            pair.offset1 = record.offset1;
+            pair.offset2 = record.offset2;
+            if (batch_pairs == batch_size) write_batch();
+        }
+    }
+    write_batch();
+
+    // --------------------------------------------------------------------------------
+    //                                     Cleanup                                    |
+    // --------------------------------------------------------------------------------
+
+    ofstream compression_report;
+    if (compressor) {
+        compression_report.open(out_dir + "/compression.tsv");
+        bucketWriterPool::report_header(compression_report);
+    }
+    double compress_wait_ms = 0;
+    for (auto &pool : pools) {
+        pool->close_all();
+        compress_wait_ms += pool->compress_wait_ms;
+        if (compressor) pool->report(compression_report);
+        delete pool;
+    }
+    if (manifest) {
+        close(R1_fd);
+        close(R2_fd);
+        delete manifest;
+    }
+
+    metrics->add("written_bytes", written_bytes);
+    metrics->set("compress_wait_ms", compress_wait_ms);
+    auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "Scanned %lu pairs, dumped %lu into %s in %.1fs using %d threads.\n",
+            (unsigned long) scanned_pairs, (unsigned long) written_pairs, out_dir.c_str(), sec, threads);
+    if (compressor) {
+        compressor->print_summary(compress_wait_ms);
+        delete compressor;
+    }
+
+    metrics->end_stage();
+    return written_pairs;
+}
@@ -128,6 +128,106 @@ Omnigraph::classifyRead(kDataFrame *kf, std::vector<kmer_row> &kmers, int PE) {
 
 }
 
+// Invalid and masked k-mers are never looked up.
+uint64_t Omnigraph::lookup_color(kDataFrame *kf, uint64_t hash) {
+    if (hash >= MASKED_KMER) return 0;
+    uint64_t color = kf->getCount(hash);
+    this->lookups++;
+    this->lookup_hits += color != 0;
+    return color;
+}
+
+// Same scenarios as above, computed on the decoder's hashes.
+// Quality-masked k-mers are unknown: the terminal k-mers are the outermost unmasked ones and the
+// found ratio is taken over unmasked k-mers only.
+// The constructed read is a view into `read`, and the colors are tracked in a single pass, so no
+// allocation happens per read.
+tuple<string_view, bool, int, uint32_t>
+Omnigraph::classifyRead(kDataFrame *kf, decoded_read &read, int PE) {
+
+    int scenario = 0;
+    vector<uint64_t> &hashes = read.hashes;
+    string_view seq = read.seq;
+
+    size_t first_kmer = 0, last_kmer = hashes.size();
+    while (first_kmer < hashes.size() && hashes[first_kmer] == MASKED_KMER) first_kmer++;
+    while (last_kmer > first_kmer && hashes[last_kmer - 1] == MASKED_KMER) last_kmer--;
+
+    if (first_kmer == last_kmer) {
+        scenario = 6;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(seq, false, scenario, 0);
+    }
+
+    int kSize = read.seq.size() - hashes.size() + 1;
+    uint64_t color1 = lookup_color(kf, hashes[first_kmer]);
+    uint64_t color2 = lookup_color(kf, hashes[last_kmer - 1]);
+
+    if (color1 != 0 && color2 != 0) {
+
+        if (color1 == color2) {
+            scenario = 1;
+            this->scenarios_count[PE][scenario]++;
+            return make_tuple(seq, true, scenario, color1);
+        } else {
+            scenario = 2;
+            this->scenarios_count[PE][scenario]++;
+            return make_tuple(seq, false, scenario, 0);
+        }
+    }
+
+    // unique_colors of the text path is {0} + the distinct non-zero colors, only its size up to 3 matters.
+    double noKmers = 0;
+    double found_count = 0;
+    bool has_unmatched = false;
+    int distinct_colors = 0;
+    uint64_t collectiveComponent = 0;
+    size_t start_kmer = 0, end_kmer = 0;
+
+    for (size_t i = first_kmer; i < last_kmer; i++) {
+        if (hashes[i] == MASKED_KMER) continue;
+        noKmers++;
+        uint64_t color = (i == first_kmer) ? color1 : (i == last_kmer - 1) ? color2 : lookup_color(kf, hashes[i]);
+        if (color == 0) {
+            has_unmatched = true;
+            continue;
+        }
+        if (found_count == 0) {
+            collectiveComponent = color;
+            start_kmer = i;
+            distinct_colors = 1;
+        } else if (color != collectiveComponent) {
+            distinct_colors = 2;
+        }
+        end_kmer = i;
+        found_count++;
+    }
+
+    int unique_colors = distinct_colors + has_unmatched;
+
+    if ((found_count / noKmers) < 0.5) {
+        scenario = 3;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(seq, false, scenario, 0);
+    }
+
+    if (unique_colors > 2) {
+        scenario = 4;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(seq, false, scenario, 0);
+    } else if (unique_colors == 2) {
+        // First and last matched k-mers delimit the trimmed read.
+        scenario = 5;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(seq.substr(start_kmer, end_kmer - start_kmer + kSize), true, scenario,
+                          collectiveComponent);
+    } else {
+        scenario = 6;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(seq, false, scenario, 0);
+    }
+}
+
 string Omnigraph::kmers_to_seq(vector<kmer_row> &kmers) {
     string seq;
     int kSize = kmers[0].str.size();
@@ -140,7 +240,7 @@ string Omnigraph::kmers_to_seq(vector<kmer_row> &kmers) {
 
 // tuple<seq, matched, scenario, component, found_ratio>
 tuple<string, bool, int, uint32_t, double>
-Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers, int PE) {
+Omnigraph::classifyRead_withStats(kDataFrame *kf, decoded_read &read, int PE) {
 
 
     /*
@@ -156,31 +256,46 @@ Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers,
     string constructed_read;
     int scenario = 0;
     int connected_component;
-    double noKmers = (double) kmers.size();
+    vector<uint64_t> &hashes = read.hashes;
+    double noKmers = (double) hashes.size();
+
+    size_t first_kmer = 0, last_kmer = hashes.size();
+    while (first_kmer < hashes.size() && hashes[first_kmer] == MASKED_KMER) first_kmer++;
+    while (last_kmer > first_kmer && hashes[last_kmer - 1] == MASKED_KMER) last_kmer--;
+
+    if (first_kmer == last_kmer) {
+        scenario = 6;
+        this->scenarios_count[PE][scenario]++;
+        return make_tuple(read.seq, false, scenario, 0, 0.0);
+    }
 
     vector<uint64_t> all_colors;
     phmap::flat_hash_set<uint64_t> unique_colors;
     double found_count = 0;
 
-    // Get all the colors
-    for (const auto &kmer: kmers) {
-        uint64_t color = kf->getCount(kmer.hash);
+    // Get all the colors, masked k-mers are left out of the ratio
+    for (const auto &hash : hashes) {
+        uint64_t color = lookup_color(kf, hash);
+        all_colors.push_back(color);
+        if (hash == MASKED_KMER) {
+            noKmers--;
+            continue;
+        }
         if (color != 0) {
             found_count++;
         }
-        all_colors.push_back(color);
         unique_colors.insert(color);
     }
 
     double found_ratio = found_count / noKmers;
 
-    uint64_t color1 = all_colors.front();
-    uint64_t color2 = all_colors.back();
+    uint64_t color1 = all_colors[first_kmer];
+    uint64_t color2 = all_colors[last_kmer - 1];
 
     if (color1 != 0 && color2 != 0) {
 
         if (color1 == color2) {
-            constructed_read = kmers_to_seq(kmers);
+            constructed_read = read.seq;
             scenario = 1;
             this->scenarios_count[PE][scenario]++;
             connected_component = color1;
@@ -189,7 +304,7 @@ Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers,
         } else {
             scenario = 2;
             this->scenarios_count[PE][scenario]++;
-            constructed_read = kmers_to_seq(kmers);
+            constructed_read = read.seq;
             return make_tuple(constructed_read, false, scenario, 0, found_ratio);
         }
     } else {
@@ -204,7 +319,7 @@ Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers,
 
             scenario = 3;
             this->scenarios_count[PE][scenario]++;
-            constructed_read = kmers_to_seq(kmers);
+            constructed_read = read.seq;
             return make_tuple(constructed_read, false, scenario, 0, found_ratio);
 
         } else {
@@ -214,7 +329,7 @@ Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers,
 
                 scenario = 4;
                 this->scenarios_count[PE][scenario]++;
-                constructed_read = kmers_to_seq(kmers);
+                constructed_read = read.seq;
                 return make_tuple(constructed_read, false, scenario, 0, found_ratio);
             } else if (unique_colors.size() == 2) { // This is important, to assure there's an exact one color found.
 
@@ -253,16 +368,15 @@ Omnigraph::classifyRead_withStats(kDataFrame *kf, std::vector<kmer_row> &kmers,
                 scenario = 5;
                 this->scenarios_count[PE][scenario]++;
 
-                vector<kmer_row> sliced_kmers = std::vector<kmer_row>(kmers.begin() + start_kmer,
-                                                                      kmers.begin() + end_kmer + 1);
-                constructed_read = kmers_to_seq(sliced_kmers);
+                int kSize = read.seq.size() - hashes.size() + 1;
+                constructed_read = read.seq.substr(start_kmer, end_kmer - start_kmer + kSize);
 
                 return make_tuple(constructed_read, true, scenario, connectedComponent, found_ratio);
 
             } else {
                 scenario = 6;
                 this->scenarios_count[PE][scenario]++;
-                constructed_read = kmers_to_seq(kmers);
+                constructed_read = read.seq;
                 return make_tuple(constructed_read, false, scenario, 0, found_ratio);
             }
         }
@@ -0,0 +1,104 @@
+#include "pairsCount.hpp"
+#include <fstream>
+#include <stdexcept>
+
+pairs_count::pairs_count(string prefix, int shards_log2) {
+    this->prefix = std::move(prefix);
+    this->shards_log2 = max(1, min(shards_log2, 16));
+    this->shards.reset(new shard[(size_t) 1 << this->shards_log2]);
+}
+
+void pairs_count::insert_pair(uint32_t comp1, uint32_t comp2) {
+    uint64_t key = pack(comp1, comp2);
+    shard &s = this->shards[this->shard_of(key)];
+    lock_guard<mutex> lock(s.mtx);
+    s.counts[key]++;
+}
+
+void pairs_count::insert_pairs(vector<uint64_t> &keys) {
+    sort(keys.begin(), keys.end(), [this](uint64_t a, uint64_t b) { return this->shard_of(a) < this->shard_of(b); });
+
+    size_t i = 0;
+    while (i < keys.size()) {
+        size_t shard_id = this->shard_of(keys[i]);
+        shard &s = this->shards[shard_id];
+        lock_guard<mutex> lock(s.mtx);
+        for (; i < keys.size() && this->shard_of(keys[i]) == shard_id; i++) s.counts[keys[i]]++;
+    }
+}
+
+size_t pairs_count::size() {
+    size_t total = 0;
+    for (size_t s = 0; s < ((size_t) 1 << this->shards_log2); s++) total += this->shards[s].counts.size();
+    return total;
+}
+
+vector<pair<uint64_t, uint32_t>> pairs_count::sorted_pairs(uint32_t cutoff) {
+    vector<pair<uint64_t, uint32_t>> pairs;
+    pairs.reserve(this->size());
+    for (size_t s = 0; s < ((size_t) 1 << this->shards_log2); s++) {
+        for (auto &entry : this->shards[s].counts) {
+            if (entry.second >= cutoff) pairs.emplace_back(entry.first, entry.second);
+        }
+    }
+    sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+void pairs_count::tsv_export(uint32_t cutoff) {
+    ofstream tsvWriter(this->prefix + "_pairsCount.tsv");
+    tsvWriter << "comp1\tcomp2\tcount\n";
+    string line;
+    for (auto &entry : this->sorted_pairs(cutoff)) {
+        line = to_string(first(entry.first)) + '\t';
+        line.append(to_string(second(entry.first)) + '\t');
+        line.append(to_string(entry.second) + '\n');
+        tsvWriter << line;
+    }
+    tsvWriter.close();
+}
+
+void pairs_count::binary_export(uint32_t cutoff) {
+    auto pairs = this->sorted_pairs(cutoff);
+    vector<uint64_t> keys(pairs.size());
+    vector<uint32_t> counts(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        keys[i] = pairs[i].first;
+        counts[i] = pairs[i].second;
+    }
+
+    ofstream out(this->prefix + "_pairsCount.bin", ios::binary | ios::trunc);
+    pairs_count_header header{PAIRS_COUNT_MAGIC, pairs.size(), cutoff, 0};
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) keys.data(), keys.size() * sizeof(uint64_t));
+    out.write((const char *) counts.data(), counts.size() * sizeof(uint32_t));
+}
+
+void pairs_count::binary_import(const string &file_name) {
+    ifstream in(file_name, ios::binary);
+    pairs_count_header header{};
+    in.read((char *) &header, sizeof(header));
+    if (!in || header.magic != PAIRS_COUNT_MAGIC) {
+        throw runtime_error(file_name + " is not a binary pairs count");
+    }
+
+    vector<uint64_t> keys(header.n_pairs);
+    vector<uint32_t> counts(header.n_pairs);
+    in.read((char *) keys.data(), keys.size() * sizeof(uint64_t));
+    in.read((char *) counts.data(), counts.size() * sizeof(uint32_t));
+    if (!in) {
+        throw runtime_error("truncated pairs count " + file_name);
+    }
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        shard &s = this->shards[this->shard_of(keys[i])];
+        s.counts[keys[i]] += counts[i];
+    }
+}
+
+bool pairs_count::is_binary(const string &file_name) {
+    ifstream in(file_name, ios::binary);
+    uint64_t magic = 0;
+    in.read((char *) &magic, sizeof(magic));
+    return in && magic == PAIRS_COUNT_MAGIC;
+}
@@ -0,0 +1,143 @@
+#include "partitionManifest.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+
+manifestStore::manifestStore(const string &path, const string &R1_file, const string &R2_file) {
+    this->path = path;
+    this->out.open(path, ios::binary | ios::trunc);
+    if (!this->out.is_open()) {
+        throw runtime_error("could not create the manifest " + path);
+    }
+
+    this->header.magic = MANIFEST_MAGIC;
+    this->header.R1_path_length = R1_file.size();
+    this->header.R2_path_length = R2_file.size();
+    this->out.write((const char *) &this->header, sizeof(this->header));
+    this->out.write(R1_file.data(), R1_file.size());
+    this->out.write(R2_file.data(), R2_file.size());
+
+    // Records start 8-byte aligned so the reader can use them in place.
+    size_t padding = (8 - (sizeof(this->header) + R1_file.size() + R2_file.size()) % 8) % 8;
+    this->out.write("\0\0\0\0\0\0\0", padding);
+
+    this->load_start = chrono::high_resolution_clock::now();
+}
+
+void manifestStore::bulk_insert(const std::pmr::vector<PE_row> &rows) {
+    this->records.resize(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        this->records[i] = {rows[i].offset1, rows[i].offset2, rows[i].comp1, rows[i].comp2};
+    }
+    this->out.write((const char *) this->records.data(), this->records.size() * sizeof(manifest_record));
+    this->header.n_pairs += rows.size();
+}
+
+void manifestStore::end_bulk_load() {
+    this->out.seekp(0);
+    this->out.write((const char *) &this->header, sizeof(this->header));
+    this->out.close();
+    cerr << "Manifest: " << this->header.n_pairs << " pairs (" << (long) this->rows_per_sec() << " rows/s) in "
+         << this->path << endl;
+}
+
+double manifestStore::rows_per_sec() {
+    double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - this->load_start).count();
+    return sec > 0 ? this->header.n_pairs / sec : 0;
+}
+
+manifestReader::manifestReader(const string &path) {
+    this->fd = open(path.c_str(), O_RDONLY);
+    if (this->fd == -1) {
+        throw runtime_error("could not open the manifest " + path);
+    }
+
+    struct stat st{};
+    fstat(this->fd, &st);
+    this->mapped_size = st.st_size;
+    if (this->mapped_size < sizeof(manifest_header)) {
+        throw runtime_error("truncated manifest " + path);
+    }
+    this->mapped = mmap(nullptr, this->mapped_size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+    if (this->mapped == MAP_FAILED) {
+        this->mapped = nullptr;
+        throw runtime_error("could not map the manifest " + path);
+    }
+    madvise(this->mapped, this->mapped_size, MADV_SEQUENTIAL);
+
+    auto *header = (const manifest_header *) this->mapped;
+    if (header->magic != MANIFEST_MAGIC) {
+        throw runtime_error(path + " is not an omnigraph manifest");
+    }
+
+    const char *p = (const char *) this->mapped + sizeof(manifest_header);
+    this->R1_file.assign(p, header->R1_path_length);
+    p += header->R1_path_length;
+    this->R2_file.assign(p, header->R2_path_length);
+
+    size_t records_start = sizeof(manifest_header) + header->R1_path_length + header->R2_path_length;
+    records_start += (8 - records_start % 8) % 8;
+    this->n_pairs = header->n_pairs;
+    if (records_start + this->n_pairs * sizeof(manifest_record) > this->mapped_size) {
+        throw runtime_error("truncated manifest " + path);
+    }
+    this->records = (const manifest_record *) ((const char *) this->mapped + records_start);
+}
+
+bool manifestReader::read_sequence(int fd, uint64_t offset, vector<char> &window, string &seq) {
+    while (true) {
+        ssize_t n = pread(fd, window.data(), window.size(), offset);
+        if (n <= 0) return false;
+        bool at_eof = (size_t) n < window.size();
+        const char *p = window.data(), *end = window.data() + n;
+
+        const char *header_end = (const char *) memchr(p, '\n', end - p);
+        if (header_end == nullptr) {
+            if (at_eof) return false;
+            window.resize(window.size() * 2);
+            continue;
+        }
+
+        seq.clear();
+        char marker = *p;
+        p = header_end + 1;
+        bool complete = false;
+        while (p < end) {
+            if (marker == '>' && *p == '>') {
+                complete = true;
+                break;
+            }
+            const char *line_end = (const char *) memchr(p, '\n', end - p);
+            if (line_end == nullptr) break;
+            const char *last = line_end;
+            if (last > p && last[-1] == '\r') last--;
+            seq.append(p, last - p);
+            p = line_end + 1;
+            // FASTQ: the sequence is a single line
+            if (marker == '@') {
+                complete = true;
+                break;
+            }
+        }
+
+        if (complete || at_eof) {
+            // Last FASTA record without a trailing newline
+            if (!complete && p < end) {
+                const char *last = end;
+                if (last[-1] == '\r') last--;
+                seq.append(p, last - p);
+            }
+            return true;
+        }
+        window.resize(window.size() * 2);
+    }
+}
+
+manifestReader::~manifestReader() {
+    if (this->mapped) munmap(this->mapped, this->mapped_size);
+    if (this->fd != -1) close(this->fd);
+}
@@ -0,0 +1,363 @@
+#include "primaryPartitioning.hpp"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <omp.h>
+#include "omnigraph.hpp"
+#include "readsDecoder.hpp"
+#include "asyncDBWriter.hpp"
+#include "columnStore.hpp"
+#include "bucketWriterPool.hpp"
+#include "partitionManifest.hpp"
+#include "batchTuner.hpp"
+#include "runMetrics.hpp"
+
+void primary_partitioning(kDataFrame *kf, const partitioning_options &options, partitioning_result &result) {
+
+    const string &PE_1_reads_file = options.PE_1_reads_file, &PE_2_reads_file = options.PE_2_reads_file;
+    const string &out_prefix = options.out_prefix, &store_type = options.store_type;
+    int batchSize = options.batchSize;
+    int kSize = (int) kf->getkSize();
+    int no_of_sequences = options.no_of_sequences;
+    int hashing_mode = options.hashing_mode;
+    int min_quality = options.min_quality;
+    int threads = max(1, options.threads);
+    bool resume = options.resume;
+    runMetrics local_metrics;
+    runMetrics *metrics = options.metrics ? options.metrics : &local_metrics;
+    metrics->begin_stage("partition");
+
+    string sqlite_db = out_prefix + "_omni.db";
+    if (store_type != "sqlite" && store_type != "columnar" && store_type != "partitions" && store_type != "manifest") {
+        throw runtime_error("unknown store: " + store_type);
+    }
+    if (resume && store_type != "sqlite") {
+        throw runtime_error("--resume needs --store sqlite.");
+    }
+
+    cerr << "Processing: \nR1: " << PE_1_reads_file << "\nR2: " << PE_2_reads_file << endl;
+
+    // Instantiations
+    auto *originalCompsQuery = new Omnigraph();
+    run_checkpoint restart;
+    SQLiteManager *SQL = nullptr;
+    readsStore *store;
+    blockCompressor *compressor = options.gzip_level > 0
+                                  ? new blockCompressor(options.gzip_threads, options.gzip_level) : nullptr;
+    if (store_type == "columnar") {
+        // Columnar store always keeps the sequences 2-bit packed.
+        store = new columnStore(out_prefix + "_omni.cols");
+    } else if (store_type == "manifest") {
+        store = new manifestStore(out_prefix + "_omni.manifest", PE_1_reads_file, PE_2_reads_file);
+    } else if (store_type == "partitions") {
+        store = new partitionStore(out_prefix + "_partitions", options.max_open_files, compressor);
+    } else {
+        SQL = new SQLiteManager(sqlite_db);
+        SQL->create_reads_table(originalCompsQuery->partitioning_mode, options.packed_seqs);
+        if (resume) {
+            SQL->enable_checkpoints();
+            if (SQL->resume_checkpoint(restart)) {
+                fprintf(stderr, "Resuming after chunk %lu: %lu pairs done, R1 offset %lu, R2 offset %lu.\n",
+                        (unsigned long) restart.chunk, (unsigned long) restart.pairs, (unsigned long) restart.offset1,
+                        (unsigned long) restart.offset2);
+            } else {
+                cerr << "No checkpoint found, starting from the first chunk." << endl;
+            }
+        }
+        SQL->begin_bulk_load(originalCompsQuery->partitioning_mode);
+        store = SQL;
+    }
+
+    // Instantiate the readahead decoders with hashing mode 3
+    auto *READ_1_KMERS = new readsDecoder(PE_1_reads_file, batchSize, kSize, hashing_mode, options.readahead_mb,
+                                          restart.offset1);
+    auto *READ_2_KMERS = new readsDecoder(PE_2_reads_file, batchSize, kSize, hashing_mode, options.readahead_mb,
+                                          restart.offset2);
+    READ_1_KMERS->set_min_quality(min_quality);
+    READ_2_KMERS->set_min_quality(min_quality);
+    bool manifest_only = store_type == "manifest";
+    if (manifest_only && (READ_1_KMERS->compressed() || READ_2_KMERS->compressed())) {
+        delete READ_1_KMERS;
+        delete READ_2_KMERS;
+        delete store;
+        delete compressor;
+        delete originalCompsQuery;
+        throw runtime_error("--store manifest needs uncompressed reads files, record offsets can't address gzip input.");
+    }
+
+    // Initializations
+    int no_chunks = ceil((double) no_of_sequences / (double) batchSize);
+    int current_chunk = (int) restart.chunk;
+    int processed_reads = (int) restart.pairs;
+    auto *tuner = new batchTuner(batchSize, options.target_chunk_ms, options.max_chunk_mb, out_prefix + "_batchSizes.tsv");
+
+    auto *pairsCounter = new pairs_count(out_prefix);
+    uint32_t n_original = options.original_comps_file.empty()
+                          ? 0 : finalComponents::count_original_components(options.original_comps_file);
+    auto *components = new finalComponents(n_original, options.cutoff);
+    auto *writer = new asyncDBWriter(store);
+
+    // The pairs counts and component sizes of the resumed chunks are rebuilt from their rows,
+    // the scenario counts come from the checkpoint.
+    if (restart.chunk) {
+        sqlite3pp::query qry(SQL->db, "SELECT seq1_original_component, seq2_original_component FROM reads;");
+        vector<uint64_t> linked_pairs;
+        for (auto row : qry) {
+            auto comp1 = (uint32_t) row.get<long long>(0), comp2 = (uint32_t) row.get<long long>(1);
+            components->add_reads(comp1, 1);
+            components->add_reads(comp2, 1);
+            if (comp1 && comp2 && comp1 != comp2) linked_pairs.push_back(pairs_count::pack(comp1, comp2));
+        }
+        pairsCounter->insert_pairs(linked_pairs);
+        istringstream counters(restart.counters);
+        for (int p = 1; p <= 2; p++) {
+            for (int scenario = 1; scenario <= 6; scenario++) counters >> originalCompsQuery->scenarios_count[p][scenario];
+        }
+    }
+
+    // One classifier per thread, they keep their own scenario counters.
+    vector<Omnigraph *> classifiers = {originalCompsQuery};
+    for (int t = 1; t < threads; t++) classifiers.push_back(new Omnigraph());
+    vector<vector<uint64_t>> thread_pairs(threads);
+
+    struct classified_pair {
+        string_view seq1, seq2;
+        uint32_t comp1, comp2;
+    };
+    vector<classified_pair> classified;
+
+    while (!READ_1_KMERS->end() && !READ_2_KMERS->end()) {
+
+        cerr << "processing chunk: (" << ++current_chunk << ") / (" << no_chunks << ") ... ";
+        scopedTimer chunk_timer(metrics, "chunk_ms");
+
+        double io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms();
+        double parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms;
+        READ_1_KMERS->next_chunk();
+        READ_2_KMERS->next_chunk();
+        io_wait = READ_1_KMERS->io_wait_ms() + READ_2_KMERS->io_wait_ms() - io_wait;
+        parse_time = READ_1_KMERS->parse_ms + READ_2_KMERS->parse_ms - parse_time;
+
+
+        decoded_read *seq1 = READ_1_KMERS->getReads()->begin();
+        decoded_read *seq2 = READ_2_KMERS->getReads()->begin();
+        size_t chunk_pairs = min(READ_1_KMERS->getReads()->size(), READ_2_KMERS->getReads()->size());
+        if (classified.size() < chunk_pairs) classified.resize(chunk_pairs);
+
+#pragma omp parallel num_threads(threads)
+        {
+            int thread_id = omp_get_thread_num();
+            Omnigraph *classifier = classifiers[thread_id];
+            vector<uint64_t> &linked_pairs = thread_pairs[thread_id];
+            linked_pairs.clear();
+
+#pragma omp for schedule(dynamic, 1024)
+            for (size_t i = 0; i < chunk_pairs; i++) {
+                auto read_1_result = classifier->classifyRead(kf, seq1[i], 1);
+                auto read_2_result = classifier->classifyRead(kf, seq2[i], 2);
+
+                uint32_t R1_connectedComponent = get<3>(read_1_result);
+                uint32_t R2_connectedComponent = get<3>(read_2_result);
+                classified[i] = {get<0>(read_1_result), get<0>(read_2_result), R1_connectedComponent,
+                                 R2_connectedComponent};
+
+                // Pairs counter
+                if ((get<1>(read_1_result) && get<1>(read_2_result)) && (R1_connectedComponent != R2_connectedComponent)) {
+                    linked_pairs.push_back(pairs_count::pack(R1_connectedComponent, R2_connectedComponent));
+                }
+            }
+
+            pairsCounter->insert_pairs(linked_pairs);
+        }
+
+        // Buffer for holding Sqlite rows, blocks only while the writer is behind by a full queue.
+        double writer_blocked = writer->blocked_ms;
+        rowsBuffer *sqlite_chunk = writer->acquire();
+        writer_blocked = writer->blocked_ms - writer_blocked;
+        sqlite_chunk->rows.reserve(chunk_pairs);
+
+        // Rows keep the input order.
+        for (size_t i = 0; i < chunk_pairs; i++) {
+            auto &pair = classified[i];
+            components->add_reads(pair.comp1, 1);
+            components->add_reads(pair.comp2, 1);
+
+            if (manifest_only) {
+                sqlite_chunk->push_back({}, {}, pair.comp1, pair.comp2, seq1[i].offset, seq2[i].offset);
+            } else {
+                sqlite_chunk->push_back(pair.seq1, pair.seq2, pair.comp1, pair.comp2);
+            }
+        }
+
+        double classify_ms = chunk_timer.elapsed_ms();
+        cerr << "Done in: " << runMetrics::format_ms(classify_ms);
+        cerr << " (io wait: " << (long) io_wait << "ms, parse: " << (long) parse_time << "ms)";
+
+
+        // --------------------------------------------------------------------------------
+        //                              Hand over to the store writer                     |
+        // --------------------------------------------------------------------------------
+
+        scopedTimer handover_timer(metrics, "handover_ms");
+        size_t chunk_rows_bytes = sqlite_chunk->arena.used();
+        if (resume) {
+            // Committed by the writer together with this chunk's rows.
+            run_checkpoint &state = sqlite_chunk->checkpoint;
+            state.chunk = current_chunk;
+            state.pairs = processed_reads + chunk_pairs;
+            state.offset1 = READ_1_KMERS->next_record_offset();
+            state.offset2 = READ_2_KMERS->next_record_offset();
+            state.counters.clear();
+            for (int p = 1; p <= 2; p++) {
+                for (int scenario = 1; scenario <= 6; scenario++) {
+                    uint64_t count = 0;
+                    for (auto *classifier : classifiers) count += classifier->scenarios_count[p][scenario];
+                    state.counters += to_string(count) + " ";
+                }
+            }
+            sqlite_chunk->has_checkpoint = true;
+        }
+        writer->submit(sqlite_chunk);
+
+        // --------------------------------------------------------------------------------
+        //                                      Done Hand over                            |
+        // --------------------------------------------------------------------------------
+
+
+        // Hand over time only
+        uint64_t rows_written = writer->rows_written;
+        cerr << " | queued in: " << runMetrics::format_ms(handover_timer.stop()) << " (writer wait: "
+             << (long) writer_blocked << "ms, " << rows_written << " rows written)";
+
+        double chunk_ms = chunk_timer.stop();
+        cerr << " | total : " << runMetrics::format_ms(chunk_ms);
+
+        metrics->add("chunks");
+        metrics->add("pairs", chunk_pairs);
+        metrics->add("rows_bytes", chunk_rows_bytes);
+        metrics->observe("io_wait_ms", io_wait);
+        metrics->observe("parse_ms", parse_time);
+        metrics->observe("classify_ms", classify_ms);
+        metrics->observe("writer_wait_ms", writer_blocked);
+        metrics->set("bytes_read", (double) (READ_1_KMERS->bytes_read() + READ_2_KMERS->bytes_read()));
+        metrics->set("rows_written", (double) rows_written);
+
+        int chunk_reads = READ_1_KMERS->getReads()->size();
+        processed_reads += chunk_reads;
+        if (tuner->enabled()) {
+            size_t chunk_bytes = READ_1_KMERS->chunk_bytes + READ_2_KMERS->chunk_bytes + chunk_rows_bytes;
+            batchSize = tuner->update(chunk_reads, chunk_ms, chunk_bytes);
+            READ_1_KMERS->set_batch_size(batchSize);
+            READ_2_KMERS->set_batch_size(batchSize);
+            no_chunks = current_chunk + ceil((double) max(0, no_of_sequences - processed_reads) / (double) batchSize);
+            cerr << " | next batch: " << batchSize;
+        }
+        cerr << endl;
+
+    }
+
+
+    // --------------------------------------------------------------------------------
+    //                                Dumping pairCounts TSV                          |
+    // --------------------------------------------------------------------------------
+
+    writer->finish();
+    metrics->set("rows_per_sec", store->rows_per_sec());
+    {
+        scopedTimer timer(metrics, "end_bulk_load_ms");
+        store->end_bulk_load();
+    }
+
+    if (options.export_pairs) {
+        cerr << "Dumping pairCounter (" << pairsCounter->size() << " linked pairs) ..." << endl;
+        pairsCounter->tsv_export();
+        pairsCounter->binary_export();
+    }
+
+    // --------------------------------------------------------------------------------
+    //                              Dumping pairCounts TSV Done                       |
+    // --------------------------------------------------------------------------------
+
+
+    // --------------------------------------------------------------------------------
+    //                                Final components                                |
+    // --------------------------------------------------------------------------------
+
+    cerr << "Constructing final components (cutoff: " << options.cutoff << ") ..." << endl;
+    scopedTimer components_timer(metrics, "final_components_ms");
+    pairsCounter->for_each([components](uint32_t comp1, uint32_t comp2, uint32_t count) {
+        components->add_pairs_count(comp1, comp2, count);
+    });
+    components->construct();
+    components_timer.stop();
+    metrics->set("linked_pairs", (double) pairsCounter->size());
+    metrics->set("final_components", components->n_final);
+    if (options.export_components) {
+        components->binary_export(out_prefix + "_finalComponents.bin");
+        components->tsv_export(out_prefix + "_finalComponents.tsv");
+        components->sizes_tsv_export(out_prefix + "_finalComponents_sizes.tsv");
+    }
+    cerr << "Final components: " << components->n_final << " (" << components->n_connected << " connected, "
+         << components->n_final - components->n_connected << " isolated), " << components->edges_used
+         << " edges used, " << components->edges_filtered << " below cutoff." << endl;
+
+
+    // Printing a summary report
+
+    for (int t = 1; t < threads; t++) {
+        for (int p = 1; p <= 2; p++) {
+            for (int scenario = 1; scenario <= 6; scenario++) {
+                originalCompsQuery->scenarios_count[p][scenario] += classifiers[t]->scenarios_count[p][scenario];
+            }
+        }
+        originalCompsQuery->lookups += classifiers[t]->lookups;
+        originalCompsQuery->lookup_hits += classifiers[t]->lookup_hits;
+        delete classifiers[t];
+    }
+    metrics->add("lookups", originalCompsQuery->lookups);
+    metrics->add("lookup_hits", originalCompsQuery->lookup_hits);
+
+    for (int p = 1; p <= 2; p++) {
+        double total = 0;
+        for (int scenario = 1; scenario <= 6; scenario++)
+            total += originalCompsQuery->scenarios_count[p][scenario];
+
+        double mapped_percentage = (originalCompsQuery->scenarios_count[p][1] +
+                                    originalCompsQuery->scenarios_count[p][5]);
+        mapped_percentage = (mapped_percentage / total) * 100;
+
+        cout << "Paired End File: " << p << " | mapped_reads  %" << mapped_percentage << endl;
+        for (int scenario = 1; scenario <= 6; scenario++) {
+            int count = originalCompsQuery->scenarios_count[p][scenario];
+            string description = originalCompsQuery->scenario_descriptions[scenario];
+            cout << "Scenario (" << scenario << ") : Count: " << count << " | " << description << endl;
+            metrics->add("R" + to_string(p) + ".scenario_" + to_string(scenario), count);
+        }
+        cout << "---------------------------------" << endl;
+    }
+
+    if (min_quality > 0) {
+        cout << "Quality-masked kmers (phred < " << min_quality << "): R1: " << READ_1_KMERS->masked_kmers
+             << " | R2: " << READ_2_KMERS->masked_kmers << endl;
+    }
+
+    if (SQL) SQL->close();
+    delete store;
+    delete compressor;
+    delete READ_1_KMERS;
+    delete READ_2_KMERS;
+    delete writer;
+    tuner->close();
+    delete tuner;
+    delete originalCompsQuery;
+
+    result.pairs = pairsCounter;
+    result.components = components;
+    if (store_type == "columnar") result.reads_path = out_prefix + "_omni.cols";
+    else if (store_type == "manifest") result.reads_path = out_prefix + "_omni.manifest";
+    else if (store_type == "partitions") result.reads_path = out_prefix + "_partitions";
+    else result.reads_path = sqlite_db;
+    metrics->end_stage();
+}
@@ -0,0 +1,208 @@
+#include "queryServer.hpp"
+#include "omnigraph.hpp"
+#include "readsDecoder.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+
+bool lineChannel::read_line(string &line) {
+    while (true) {
+        size_t newline = this->in.find('\n', this->in_pos);
+        if (newline != string::npos) {
+            line.assign(this->in, this->in_pos, newline - this->in_pos);
+            this->in_pos = newline + 1;
+            return true;
+        }
+        this->in.erase(0, this->in_pos);
+        this->in_pos = 0;
+
+        char buffer[64 * 1024];
+        ssize_t n = ::read(this->fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            // Last line without a newline
+            if (this->in.empty()) return false;
+            line.swap(this->in);
+            this->in.clear();
+            return true;
+        }
+        this->in.append(buffer, n);
+    }
+}
+
+bool lineChannel::write(const string &data) {
+    this->out.append(data);
+    return this->out.size() < 64 * 1024 || this->flush();
+}
+
+bool lineChannel::flush() {
+    size_t sent = 0;
+    while (sent < this->out.size()) {
+        ssize_t n = ::send(this->fd, this->out.data() + sent, this->out.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    this->out.clear();
+    return true;
+}
+
+int connect_query_socket(const string &socket_path) {
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path)) return -1;
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (sockaddr *) &addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+queryServer::queryServer(kDataFrame *kf, int kSize, int hashing_mode, const string &socket_path) {
+    this->kf = kf;
+    this->kSize = kSize;
+    this->hashing_mode = hashing_mode;
+    this->socket_path = socket_path;
+}
+
+bool queryServer::run() {
+    sockaddr_un addr{};
+    if (this->socket_path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", this->socket_path.c_str());
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, this->socket_path.c_str());
+
+    // A leftover socket file of a dead server is replaced, a live server keeps its socket.
+    int probe = connect_query_socket(this->socket_path);
+    if (probe != -1) {
+        close(probe);
+        fprintf(stderr, "a server is already listening on %s\n", this->socket_path.c_str());
+        return false;
+    }
+    unlink(this->socket_path.c_str());
+
+    this->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listen_fd == -1 || bind(this->listen_fd, (sockaddr *) &addr, sizeof(addr)) == -1 ||
+        listen(this->listen_fd, 64) == -1) {
+        fprintf(stderr, "could not listen on %s: %s\n", this->socket_path.c_str(), strerror(errno));
+        return false;
+    }
+    fprintf(stderr, "Listening on %s\n", this->socket_path.c_str());
+
+    while (!this->stopping) {
+        int fd = accept(this->listen_fd, nullptr, nullptr);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        lock_guard<mutex> lock(this->connections_mutex);
+        this->reap_connections();
+        uint64_t id = this->next_connection++;
+        this->connections.emplace(id, thread(&queryServer::serve_connection, this, fd, id));
+    }
+
+    // Open connections may still finish (and register) while the others are joined.
+    unique_lock<mutex> lock(this->connections_mutex);
+    map<uint64_t, thread> open_connections;
+    open_connections.swap(this->connections);
+    lock.unlock();
+    for (auto &connection : open_connections) connection.second.join();
+    lock.lock();
+    this->finished_connections.clear();
+    return true;
+}
+
+void queryServer::reap_connections() {
+    for (uint64_t id : this->finished_connections) {
+        auto connection = this->connections.find(id);
+        connection->second.join();
+        this->connections.erase(connection);
+    }
+    this->finished_connections.clear();
+}
+
+void queryServer::serve_connection(int fd, uint64_t id) {
+    // Each connection classifies with its own state, the index is shared read-only.
+    Omnigraph classifier;
+    kmerHasher hasher(this->kSize, this->hashing_mode);
+    decoded_read read;
+    lineChannel channel(fd);
+    string request, response;
+
+    // Reads shorter than k have no hashes and come out as scenario 6.
+    auto classify = [&](const string &name, decoded_read &read) -> bool {
+        auto result = classifier.classifyRead(this->kf, read, 1);
+        bool mapped = get<1>(result);
+        response.clear();
+        response.append(name).append("\t").append(mapped ? "1" : "0").append("\t");
+        response.append(to_string(get<2>(result))).append("\t").append(to_string(get<3>(result))).append("\n");
+        return mapped;
+    };
+
+    while (channel.read_line(request)) {
+        this->served_requests++;
+        if (request.compare(0, 4, "SEQ ") == 0) {
+            size_t space = request.find(' ', 4);
+            if (space == string::npos) {
+                channel.write("ERR SEQ expects <name> <sequence>\n");
+                continue;
+            }
+            string name = request.substr(4, space - 4);
+            read.seq.assign(request, space + 1, string::npos);
+            hasher.hash_read(read);
+            classify(name, read);
+            this->served_reads++;
+            channel.write(response);
+        } else if (request.compare(0, 5, "FILE ") == 0) {
+            string path = request.substr(5);
+            uint64_t reads = 0, mapped = 0;
+            try {
+                readsDecoder decoder(path, 10000, this->kSize, this->hashing_mode);
+                while (!decoder.end()) {
+                    decoder.next_chunk();
+                    for (auto &file_read : *decoder.getReads()) {
+                        reads++;
+                        string name = file_read.name.substr(0, file_read.name.find_first_of(" \t"));
+                        mapped += classify(name, file_read);
+                        if (!channel.write(response)) break;
+                    }
+                }
+                channel.write("OK " + to_string(reads) + " " + to_string(mapped) + "\n");
+            } catch (const runtime_error &error) {
+                channel.write(string("ERR ") + error.what() + "\n");
+            }
+            this->served_reads += reads;
+        } else if (request == "PING") {
+            channel.write("PONG\n");
+        } else if (request == "QUIT") {
+            break;
+        } else if (request == "SHUTDOWN") {
+            this->stopping = true;
+            shutdown(this->listen_fd, SHUT_RDWR);
+            break;
+        } else if (!request.empty()) {
+            channel.write("ERR unknown request: " + request.substr(0, 32) + "\n");
+        }
+
+        // Interactive clients wait for each answer, pipelining ones get theirs once their requests are drained.
+        if (!channel.pending() && !channel.flush()) break;
+    }
+    channel.flush();
+    close(fd);
+
+    lock_guard<mutex> lock(this->connections_mutex);
+    this->finished_connections.push_back(id);
+}
+
+queryServer::~queryServer() {
+    if (this->listen_fd != -1) {
+        close(this->listen_fd);
+        unlink(this->socket_path.c_str());
+    }
+}
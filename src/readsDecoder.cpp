@@ -0,0 +1,143 @@
+#include "readsDecoder.hpp"
+#include <chrono>
+
+readsDecoder::readsDecoder(const string &filename, int batchSize, int kSize, int hashing_mode, size_t readahead_mb,
+                           uint64_t start_offset) {
+    this->batchSize = batchSize;
+    this->reader = new asyncReader(filename, readahead_mb, 8, start_offset);
+    this->line_offset = start_offset;
+    this->hasher = new kmerHasher(kSize, hashing_mode);
+}
+
+bool readsDecoder::next_line(string &line) {
+    line.clear();
+    bool started = false;
+    while (true) {
+        if (this->block_pos == this->block_length) {
+            uint64_t end_offset = this->reader->block_offset + this->block_length;
+            if (!this->reader->next_block(this->block, this->block_length)) {
+                // At end of input the resume point is the end of the last block.
+                if (this->block != nullptr) this->line_offset = end_offset;
+                this->block = nullptr;
+                this->block_length = this->block_pos = 0;
+                return !line.empty();
+            }
+            this->block_pos = 0;
+        }
+
+        if (!started) {
+            this->line_offset = this->reader->block_offset + this->block_pos;
+            started = true;
+        }
+
+        const char *start = this->block + this->block_pos;
+        size_t remaining = this->block_length - this->block_pos;
+        const char *newline = seqEncoder::find_newline(start, start + remaining);
+
+        if (newline == nullptr) {
+            line.append(start, remaining);
+            this->block_pos = this->block_length;
+            continue;
+        }
+
+        line.append(start, newline - start);
+        this->block_pos += (newline - start) + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+}
+
+bool readsDecoder::next_record(decoded_read &read) {
+    read.seq.clear();
+    read.qual.clear();
+
+    if (this->has_pending_header) {
+        this->line.swap(this->pending_header);
+        this->line_offset = this->pending_offset;
+        this->has_pending_header = false;
+    } else {
+        do {
+            if (!this->next_line(this->line)) return false;
+        } while (this->line.empty());
+    }
+
+    read.offset = this->line_offset;
+    char marker = this->line[0];
+    read.name.assign(this->line, 1, string::npos);
+
+    // FASTQ: header, sequence, '+', quality
+    if (marker == '@') {
+        this->next_line(read.seq);
+        this->next_line(this->line);
+        this->next_line(read.qual);
+        return true;
+    }
+
+    // FASTA: sequence may span multiple lines until the next header
+    while (this->next_line(this->line)) {
+        if (!this->line.empty() && this->line[0] == '>') {
+            this->pending_header.swap(this->line);
+            this->pending_offset = this->line_offset;
+            this->has_pending_header = true;
+            return true;
+        }
+        read.seq.append(this->line);
+    }
+    return true;
+}
+
+void readsDecoder::next_chunk() {
+    auto t1 = chrono::high_resolution_clock::now();
+    double io_before = this->reader->io_wait_ms;
+
+    if (this->chunk.size() < (size_t) this->batchSize) this->chunk.resize(this->batchSize);
+    this->chunk_reads = 0;
+    this->chunk_bytes = 0;
+
+    while (this->chunk_reads < (size_t) this->batchSize) {
+        auto &read = this->chunk[this->chunk_reads];
+        if (!this->next_record(read)) {
+            this->finished = true;
+            break;
+        }
+        this->hasher->hash_read(read);
+        if (this->min_quality > 0 && !read.qual.empty()) {
+            this->masked_kmers += kmerHasher::mask_low_quality(read, this->min_quality);
+        }
+        this->chunk_bytes += read.name.size() + read.seq.size() + read.qual.size() + read.hashes.size() * sizeof(uint64_t);
+        this->chunk_reads++;
+    }
+    this->current.first = this->chunk.data();
+    this->current.last = this->chunk.data() + this->chunk_reads;
+
+    double elapsed = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t1).count();
+    this->parse_ms += elapsed - (this->reader->io_wait_ms - io_before);
+}
+
+void readsDecoder::set_min_quality(int min_quality) {
+    this->min_quality = min_quality;
+}
+
+uint64_t readsDecoder::next_record_offset() {
+    // A FASTA record ends at the next header, which is already read.
+    if (this->has_pending_header) return this->pending_offset;
+    if (this->block == nullptr) return this->line_offset;
+    return this->reader->block_offset + this->block_pos;
+}
+
+bool readsDecoder::end() {
+    return this->finished;
+}
+
+void readsDecoder::set_batch_size(int batchSize) {
+    this->batchSize = batchSize;
+}
+
+readsChunk *readsDecoder::getReads() {
+    return &this->current;
+}
+
+readsDecoder::~readsDecoder() {
+    delete this->reader;
+    delete this->hasher;
+}
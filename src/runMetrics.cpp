@@ -0,0 +1,224 @@
+#include "runMetrics.hpp"
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+void runMetrics::histogram::observe(double value) {
+    if (this->count == 0 || value < this->min) this->min = value;
+    if (this->count == 0 || value > this->max) this->max = value;
+    this->count++;
+    this->sum += value;
+    size_t bucket = value < 1 ? 0 : (size_t) ilogb(value) + 1;
+    this->buckets[std::min(bucket, this->buckets.size() - 1)]++;
+}
+
+double runMetrics::histogram::quantile(double q) const {
+    if (this->count == 0) return 0;
+    auto rank = (uint64_t) ceil(q * (double) this->count);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < this->buckets.size(); b++) {
+        seen += this->buckets[b];
+        if (seen >= rank) return std::max(this->min, std::min(this->max, ldexp(1.0, (int) b)));
+    }
+    return this->max;
+}
+
+runMetrics::runMetrics(const string &output_file, double interval_sec) {
+    this->output_file = output_file;
+    if (output_file.empty() || interval_sec <= 0) return;
+    this->periodic = thread([this, interval_sec]() {
+        unique_lock<mutex> lock(this->mtx);
+        auto interval = chrono::duration<double>(interval_sec);
+        while (!this->cv_stop.wait_for(lock, interval, [this]() { return this->stopping; })) {
+            lock.unlock();
+            this->write_output();
+            lock.lock();
+        }
+    });
+}
+
+runMetrics::stage_metrics &runMetrics::current() {
+    if (this->stages.empty() || !this->stages.back().running) {
+        this->stages.emplace_back();
+        this->stages.back().name = "main";
+        this->stages.back().start = chrono::steady_clock::now();
+    }
+    return this->stages.back();
+}
+
+void runMetrics::begin_stage(const string &name) {
+    lock_guard<mutex> lock(this->mtx);
+    auto now = chrono::steady_clock::now();
+    if (!this->stages.empty() && this->stages.back().running) {
+        this->stages.back().running = false;
+        this->stages.back().end = now;
+    }
+    this->stages.emplace_back();
+    this->stages.back().name = name;
+    this->stages.back().start = now;
+}
+
+void runMetrics::end_stage() {
+    lock_guard<mutex> lock(this->mtx);
+    if (this->stages.empty() || !this->stages.back().running) return;
+    this->stages.back().running = false;
+    this->stages.back().end = chrono::steady_clock::now();
+}
+
+void runMetrics::add(const string &counter, uint64_t value) {
+    lock_guard<mutex> lock(this->mtx);
+    this->current().counters[counter] += value;
+}
+
+void runMetrics::set(const string &gauge, double value) {
+    lock_guard<mutex> lock(this->mtx);
+    this->current().gauges[gauge] = value;
+}
+
+void runMetrics::observe(const string &histogram, double value) {
+    lock_guard<mutex> lock(this->mtx);
+    this->current().histograms[histogram].observe(value);
+}
+
+// Stage and metric names are plain identifiers, only quotes and backslashes are escaped.
+static string json_string(const string &value) {
+    string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// nan/inf (e.g. a rate over an empty interval) aren't JSON numbers.
+static string number(double value) {
+    if (!isfinite(value)) return "null";
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6g", value);
+    return buffer;
+}
+
+void runMetrics::json_export(ostream &out) const {
+    lock_guard<mutex> lock(this->mtx);
+    auto now = chrono::steady_clock::now();
+    out << "{\"stages\": [";
+    for (size_t s = 0; s < this->stages.size(); s++) {
+        const stage_metrics &stage = this->stages[s];
+        double seconds = chrono::duration<double>((stage.running ? now : stage.end) - stage.start).count();
+        out << (s ? ",\n  " : "\n  ") << "{\"stage\": " << json_string(stage.name) << ", \"seconds\": "
+            << number(seconds) << ", \"running\": " << (stage.running ? "true" : "false");
+
+        out << ", \"counters\": {";
+        const char *sep = "";
+        for (const auto &counter : stage.counters) {
+            out << sep << json_string(counter.first) << ": " << counter.second;
+            sep = ", ";
+        }
+        out << "}, \"gauges\": {";
+        sep = "";
+        for (const auto &gauge : stage.gauges) {
+            out << sep << json_string(gauge.first) << ": " << number(gauge.second);
+            sep = ", ";
+        }
+        out << "}, \"histograms\": {";
+        sep = "";
+        for (const auto &entry : stage.histograms) {
+            const histogram &h = entry.second;
+            out << sep << json_string(entry.first) << ": {\"count\": " << h.count << ", \"sum\": " << number(h.sum)
+                << ", \"min\": " << number(h.min) << ", \"max\": " << number(h.max)
+                << ", \"mean\": " << number(h.count ? h.sum / (double) h.count : 0)
+                << ", \"p50\": " << number(h.quantile(0.5)) << ", \"p90\": " << number(h.quantile(0.9))
+                << ", \"p99\": " << number(h.quantile(0.99)) << "}";
+            sep = ", ";
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+}
+
+void runMetrics::tsv_export(ostream &out) const {
+    lock_guard<mutex> lock(this->mtx);
+    auto now = chrono::steady_clock::now();
+    out << "stage\tkind\tname\tvalue\n";
+    for (const stage_metrics &stage : this->stages) {
+        double seconds = chrono::duration<double>((stage.running ? now : stage.end) - stage.start).count();
+        out << stage.name << "\tstage\tseconds\t" << number(seconds) << "\n";
+        for (const auto &counter : stage.counters) {
+            out << stage.name << "\tcounter\t" << counter.first << "\t" << counter.second << "\n";
+        }
+        for (const auto &gauge : stage.gauges) {
+            out << stage.name << "\tgauge\t" << gauge.first << "\t" << number(gauge.second) << "\n";
+        }
+        for (const auto &entry : stage.histograms) {
+            const histogram &h = entry.second;
+            const string prefix = stage.name + "\thistogram\t" + entry.first;
+            out << prefix << ".count\t" << h.count << "\n";
+            out << prefix << ".sum\t" << number(h.sum) << "\n";
+            out << prefix << ".min\t" << number(h.min) << "\n";
+            out << prefix << ".max\t" << number(h.max) << "\n";
+            out << prefix << ".p50\t" << number(h.quantile(0.5)) << "\n";
+            out << prefix << ".p90\t" << number(h.quantile(0.9)) << "\n";
+            out << prefix << ".p99\t" << number(h.quantile(0.99)) << "\n";
+        }
+    }
+}
+
+void runMetrics::write_output() {
+    // Readers of the file never see a partial write.
+    string tmp_file = this->output_file + ".tmp";
+    ofstream out(tmp_file);
+    bool tsv = this->output_file.size() >= 4 && this->output_file.compare(this->output_file.size() - 4, 4, ".tsv") == 0;
+    if (tsv) this->tsv_export(out);
+    else this->json_export(out);
+    out.close();
+    if (!out || rename(tmp_file.c_str(), this->output_file.c_str()) != 0) {
+        cerr << "could not write the metrics to " << this->output_file << endl;
+    }
+}
+
+void runMetrics::close() {
+    if (this->periodic.joinable()) {
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->stopping = true;
+        }
+        this->cv_stop.notify_all();
+        this->periodic.join();
+    }
+    this->end_stage();
+    if (!this->output_file.empty()) this->write_output();
+    this->output_file.clear();
+}
+
+runMetrics::~runMetrics() {
+    this->close();
+}
+
+string runMetrics::format_ms(double ms) {
+    auto milli = (long) ms;
+    long min = milli / 60000;
+    milli -= 60000 * min;
+    long sec = milli / 1000;
+    milli -= 1000 * sec;
+    return to_string(min) + ":" + to_string(sec) + ":" + to_string(milli);
+}
+
+scopedTimer::scopedTimer(runMetrics *metrics, string name) : metrics(metrics), name(std::move(name)) {
+    this->t1 = chrono::steady_clock::now();
+}
+
+double scopedTimer::elapsed_ms() const {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - this->t1).count();
+}
+
+double scopedTimer::stop() {
+    double ms = this->elapsed_ms();
+    if (!this->stopped && this->metrics) this->metrics->observe(this->name, ms);
+    this->stopped = true;
+    return ms;
+}
+
+scopedTimer::~scopedTimer() {
+    this->stop();
+}
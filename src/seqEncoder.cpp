@@ -0,0 +1,305 @@
+#include "seqEncoder.hpp"
+#include <immintrin.h>
+#include <cstring>
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// Scalar kernels
+// ----------------------------------------------------------------------------
+
+static const char *find_newline_scalar(const char *begin, const char *end) {
+    return (const char *) memchr(begin, '\n', end - begin);
+}
+
+static void encode_2bit_scalar(const char *seq, size_t length, uint8_t *codes) {
+    for (size_t i = 0; i < length; i++) {
+        switch (seq[i] & 0xDF) {
+            case 'A': codes[i] = 0; break;
+            case 'C': codes[i] = 1; break;
+            case 'G': codes[i] = 2; break;
+            case 'T': codes[i] = 3; break;
+            default: codes[i] = 4;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// SSE2 kernels
+// ----------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static const char *find_newline_sse2(const char *begin, const char *end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const char *p = begin;
+    for (; p + 16 <= end; p += 16) {
+        int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), newline));
+        if (hits) return p + __builtin_ctz(hits);
+    }
+    return find_newline_scalar(p, end);
+}
+
+// code = ((c >> 1) & 3) ^ ((c >> 2) & 1) maps A,C,G,T to 0,1,2,3 in both cases.
+__attribute__((target("sse2")))
+static void encode_2bit_sse2(const char *seq, size_t length, uint8_t *codes) {
+    const __m128i case_mask = _mm_set1_epi8((char) 0xDF);
+    const __m128i three = _mm_set1_epi8(3), one = _mm_set1_epi8(1), four = _mm_set1_epi8(4);
+    const __m128i A = _mm_set1_epi8('A'), C = _mm_set1_epi8('C'), G = _mm_set1_epi8('G'), T = _mm_set1_epi8('T');
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *) (seq + i));
+        __m128i u = _mm_and_si128(c, case_mask);
+        __m128i valid = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(u, A), _mm_cmpeq_epi8(u, C)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(u, G), _mm_cmpeq_epi8(u, T)));
+        __m128i code = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(c, 1), three),
+                                     _mm_and_si128(_mm_srli_epi16(c, 2), one));
+        code = _mm_or_si128(_mm_and_si128(valid, code), _mm_andnot_si128(valid, four));
+        _mm_storeu_si128((__m128i *) (codes + i), code);
+    }
+    encode_2bit_scalar(seq + i, length - i, codes + i);
+}
+
+// ----------------------------------------------------------------------------
+// AVX2 kernels
+// ----------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static const char *find_newline_avx2(const char *begin, const char *end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const char *p = begin;
+    for (; p + 32 <= end; p += 32) {
+        unsigned hits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), newline));
+        if (hits) return p + __builtin_ctz(hits);
+    }
+    return find_newline_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static void encode_2bit_avx2(const char *seq, size_t length, uint8_t *codes) {
+    const __m256i case_mask = _mm256_set1_epi8((char) 0xDF);
+    const __m256i three = _mm256_set1_epi8(3), one = _mm256_set1_epi8(1), four = _mm256_set1_epi8(4);
+    const __m256i A = _mm256_set1_epi8('A'), C = _mm256_set1_epi8('C');
+    const __m256i G = _mm256_set1_epi8('G'), T = _mm256_set1_epi8('T');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *) (seq + i));
+        __m256i u = _mm256_and_si256(c, case_mask);
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(u, A), _mm256_cmpeq_epi8(u, C)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(u, G), _mm256_cmpeq_epi8(u, T)));
+        __m256i code = _mm256_xor_si256(_mm256_and_si256(_mm256_srli_epi16(c, 1), three),
+                                        _mm256_and_si256(_mm256_srli_epi16(c, 2), one));
+        code = _mm256_blendv_epi8(four, code, valid);
+        _mm256_storeu_si256((__m256i *) (codes + i), code);
+    }
+    encode_2bit_sse2(seq + i, length - i, codes + i);
+}
+
+// ----------------------------------------------------------------------------
+// Runtime dispatch
+// ----------------------------------------------------------------------------
+
+struct seqEncoderKernels {
+    const char *(*find_newline)(const char *, const char *);
+    void (*encode_2bit)(const char *, size_t, uint8_t *);
+    const char *isa;
+};
+
+static seqEncoderKernels select_kernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {find_newline_avx2, encode_2bit_avx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {find_newline_sse2, encode_2bit_sse2, "sse2"};
+    return {find_newline_scalar, encode_2bit_scalar, "scalar"};
+}
+
+static const seqEncoderKernels kernels = select_kernels();
+
+const char *seqEncoder::find_newline(const char *begin, const char *end) {
+    return kernels.find_newline(begin, end);
+}
+
+void seqEncoder::encode_2bit(const char *seq, size_t length, uint8_t *codes) {
+    kernels.encode_2bit(seq, length, codes);
+}
+
+const char *seqEncoder::isa() {
+    return kernels.isa;
+}
+
+// ----------------------------------------------------------------------------
+// 2-bit packing
+// ----------------------------------------------------------------------------
+
+static thread_local vector<uint8_t> pack_codes;
+
+static size_t encode_for_packing(const char *seq, size_t length) {
+    if (pack_codes.size() < length) pack_codes.resize(length);
+    seqEncoder::encode_2bit(seq, length, pack_codes.data());
+    size_t n_count = 0;
+    for (size_t i = 0; i < length; i++) n_count += (pack_codes[i] > 3);
+    return n_count;
+}
+
+size_t seqEncoder::max_packed_size(size_t length) {
+    return 2 * sizeof(uint32_t) + length * sizeof(uint32_t) + (length + 3) / 4;
+}
+
+size_t seqEncoder::pack(const char *seq, size_t length, uint8_t *out) {
+    size_t n_count = encode_for_packing(seq, length);
+    const uint8_t *codes = pack_codes.data();
+
+    auto header = (uint32_t) length;
+    memcpy(out, &header, sizeof(uint32_t));
+    header = (uint32_t) n_count;
+    memcpy(out + sizeof(uint32_t), &header, sizeof(uint32_t));
+    uint8_t *p = out + 2 * sizeof(uint32_t);
+
+    for (size_t i = 0; i < length && n_count; i++) {
+        if (codes[i] > 3) {
+            auto pos = (uint32_t) i;
+            memcpy(p, &pos, sizeof(uint32_t));
+            p += sizeof(uint32_t);
+        }
+    }
+
+    for (size_t i = 0; i < length; i += 4) {
+        uint8_t byte = 0;
+        for (size_t j = 0; j < 4; j++) {
+            uint8_t code = (i + j < length) ? codes[i + j] : 0;
+            byte = (byte << 2) | (code & 3);
+        }
+        *p++ = byte;
+    }
+
+    return p - out;
+}
+
+bool seqEncoder::unpack(const uint8_t *blob, size_t size, string &seq) {
+    static const char bases[4] = {'A', 'C', 'G', 'T'};
+    uint32_t length, n_count;
+    seq.clear();
+    if (size < 2 * sizeof(uint32_t)) return false;
+    memcpy(&length, blob, sizeof(uint32_t));
+    memcpy(&n_count, blob + sizeof(uint32_t), sizeof(uint32_t));
+    if (n_count > length ||
+        size != 2 * sizeof(uint32_t) + (uint64_t) n_count * sizeof(uint32_t) + ((uint64_t) length + 3) / 4) {
+        return false;
+    }
+    const uint8_t *n_positions = blob + 2 * sizeof(uint32_t);
+    const uint8_t *packed = n_positions + n_count * sizeof(uint32_t);
+    for (uint32_t i = 0; i < n_count; i++) {
+        uint32_t pos;
+        memcpy(&pos, n_positions + i * sizeof(uint32_t), sizeof(uint32_t));
+        if (pos >= length) return false;
+    }
+
+    seq.resize(length);
+    for (uint32_t i = 0; i < length; i++) {
+        seq[i] = bases[(packed[i / 4] >> (6 - 2 * (i % 4))) & 3];
+    }
+    for (uint32_t i = 0; i < n_count; i++) {
+        uint32_t pos;
+        memcpy(&pos, n_positions + i * sizeof(uint32_t), sizeof(uint32_t));
+        seq[pos] = 'N';
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// kmerHasher
+// ----------------------------------------------------------------------------
+
+// Same invertible integer hash kProcessor applies to canonical 2-bit k-mers (hashing mode 1).
+static inline uint64_t hash_64(uint64_t key, uint64_t mask) {
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+kmerHasher::kmerHasher(int kSize, int hashing_mode) {
+    this->kSize = kSize;
+    // Only mode 1 is reproduced here, a k-mer longer than 32 doesn't fit the 64-bit words anyway.
+    this->packed = (hashing_mode == 1 && kSize <= 32);
+    this->mask = (kSize == 32) ? UINT64_MAX : (1ULL << (2 * kSize)) - 1;
+    this->KD = new Kmers(kSize);
+    if (hashing_mode != -1) this->KD->setHashingMode(hashing_mode);
+}
+
+string kmerHasher::signature(int kSize, int hashing_mode) {
+    return "k=" + to_string(kSize) + ",hashing_mode=" + to_string(hashing_mode);
+}
+
+void kmerHasher::hash_read(const char *seq, size_t length, vector<uint64_t> &hashes) {
+    size_t k = this->kSize;
+    if (length < k) {
+        hashes.clear();
+        return;
+    }
+
+    hashes.resize(length - k + 1);
+    if (this->codes.size() < length) this->codes.resize(length);
+    uint8_t *codes = this->codes.data();
+    seqEncoder::encode_2bit(seq, length, codes);
+
+    if (this->packed) {
+        uint64_t fwd = 0, rev = 0;
+        size_t valid_run = 0;
+        const int rev_shift = 2 * (this->kSize - 1);
+        for (size_t i = 0; i < length; i++) {
+            uint64_t c = codes[i];
+            if (c > 3) {
+                valid_run = fwd = rev = 0;
+            } else {
+                fwd = ((fwd << 2) | c) & this->mask;
+                rev = (rev >> 2) | ((3 - c) << rev_shift);
+                valid_run++;
+            }
+            if (i + 1 >= k) {
+                hashes[i + 1 - k] = (valid_run >= k) ? hash_64(min(fwd, rev), this->mask) : INVALID_KMER;
+            }
+        }
+        return;
+    }
+
+    // Text hashing, N-containing k-mers are still skipped without hashing.
+    size_t last_invalid = SIZE_MAX;
+    for (size_t i = 0; i < k - 1; i++) {
+        if (codes[i] > 3) last_invalid = i;
+    }
+    for (size_t i = 0; i + k <= length; i++) {
+        if (codes[i + k - 1] > 3) last_invalid = i + k - 1;
+        if (last_invalid != SIZE_MAX && last_invalid >= i) {
+            hashes[i] = INVALID_KMER;
+        } else {
+            this->kmer_buffer.assign(seq + i, k);
+            hashes[i] = this->KD->hash_kmer(this->kmer_buffer);
+        }
+    }
+}
+
+size_t kmerHasher::mask_low_quality(decoded_read &read, int min_quality) {
+    vector<uint64_t> &hashes = read.hashes;
+    size_t kSize = read.seq.size() - hashes.size() + 1;
+    if (hashes.empty() || read.qual.size() != read.seq.size()) return 0;
+
+    const char threshold = (char) (min_quality + 33);
+    size_t masked = 0;
+    size_t last_low = SIZE_MAX;
+    for (size_t i = 0; i < read.qual.size(); i++) {
+        if (read.qual[i] < threshold) last_low = i;
+        if (i + 1 < kSize) continue;
+        size_t kmer_start = i + 1 - kSize;
+        if (last_low != SIZE_MAX && last_low >= kmer_start && hashes[kmer_start] != INVALID_KMER) {
+            hashes[kmer_start] = MASKED_KMER;
+            masked++;
+        }
+    }
+    return masked;
+}
+
+kmerHasher::~kmerHasher() {
+    delete this->KD;
+}
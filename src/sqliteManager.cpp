@@ -1,5 +1,6 @@
 #include "sqliteManager.hpp"
 #include "sqlite3pp.h"
+#include "seqEncoder.hpp"
 
 
 int SQLiteManager::callback(void *NotUsed, int argc, char **argv, char **azColName) {
@@ -11,9 +12,12 @@ int SQLiteManager::callback(void *NotUsed, int argc, char **argv, char **azColNa
     return 0;
 }
 
-void SQLiteManager::create_reads_table(int partitioning_mode) {
+void SQLiteManager::create_reads_table(int partitioning_mode, bool packed_seqs, bool persist_hashes) {
     // 1: Single iteration
     // 2: Hierarchical
+    this->partitioning_mode = partitioning_mode;
+    this->packed_seqs = packed_seqs;
+    this->persist_hashes = persist_hashes && partitioning_mode == 2;
 
     string _sqlite_checkTable = "SELECT ID FROM reads LIMIT 1";
     this->rc = sqlite3_exec(this->db.db_, _sqlite_checkTable.c_str(), this->callback, 0, &this->zErrMsg);
@@ -23,38 +27,35 @@ void SQLiteManager::create_reads_table(int partitioning_mode) {
         fprintf(stderr, "`reads` table was not found.\n");
         fprintf(stderr, "Creating `reads` table...\n");
 
-        const char *_sqlite_create_table;
-        string _sqlite_create_index;
+        string _sqlite_create_table;
+        string seq_type = packed_seqs ? "BLOB" : "TEXT";
 
         // By Default partitioning_mode = 1
 
 
         _sqlite_create_table = "CREATE TABLE IF NOT EXISTS `reads` ("
                                "`ID`	INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT UNIQUE,"
-                               "`PE_seq1`	TEXT,"
-                               "`PE_seq2`	TEXT,"
+                               "`PE_seq1`	" + seq_type + ","
+                               "`PE_seq2`	" + seq_type + ","
                                "`seq1_original_component`	INTEGER,"
                                "`seq2_original_component`	INTEGER"
                                ");";
 
-        _sqlite_create_index = "CREATE INDEX components_index ON reads (seq1_original_component, seq2_original_component);";
-
         if (partitioning_mode == 2) {
             _sqlite_create_table = "CREATE TABLE IF NOT EXISTS `reads` ("
                                    "`ID`	INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT UNIQUE,"
-                                   "`PE_seq1`	TEXT,"
-                                   "`PE_seq2`	TEXT,"
+                                   "`PE_seq1`	" + seq_type + ","
+                                   "`PE_seq2`	" + seq_type + ","
                                    "`seq1_collective_component`	INTEGER,"
                                    "`seq2_collective_component`	INTEGER,"
                                    "`seq1_original_component`	INTEGER,"
                                    "`seq2_original_component`	INTEGER"
+                                   + string(this->persist_hashes ? ",`seq1_hashes`	BLOB,`seq2_hashes`	BLOB" : "") +
                                    ");";
-            _sqlite_create_index = "CREATE INDEX components_index ON reads (seq1_collective_component);";
-
         }
 
 
-        this->rc = sqlite3_exec(this->db.db_, _sqlite_create_table, this->callback, 0, &this->zErrMsg);
+        this->rc = sqlite3_exec(this->db.db_, _sqlite_create_table.c_str(), this->callback, 0, &this->zErrMsg);
         if (this->rc != SQLITE_OK) {
             fprintf(stderr, "SQL error: %s\n", this->zErrMsg);
             sqlite3_free(this->zErrMsg);
@@ -62,17 +63,31 @@ void SQLiteManager::create_reads_table(int partitioning_mode) {
             fprintf(stderr, "Table created successfully\n");
         }
 
-        this->rc = sqlite3_exec(this->db.db_, _sqlite_create_index.c_str(), this->callback, 0, &this->zErrMsg);
-
-        if (this->rc != SQLITE_OK) {
-            fprintf(stderr, "SQL error: %s\n", this->zErrMsg);
-            sqlite3_free(this->zErrMsg);
-        } else {
-            fprintf(stderr, "DB Index created successfully.\n");
-        }
+        this->exec("CREATE TABLE IF NOT EXISTS `meta` (`key` TEXT PRIMARY KEY, `value` TEXT);");
+        this->set_meta("seq_encoding", packed_seqs ? "2bit" : "text");
 
     } else {
         fprintf(stderr, "`reads` table found.\n");
+
+        // Keep appending in the encoding the table was created with.
+        bool table_packed = false;
+        if (sqlite3_exec(this->db.db_, "SELECT 1 FROM meta LIMIT 1", nullptr, nullptr, nullptr) == SQLITE_OK) {
+            sqlite3pp::query qry(this->db, "SELECT value FROM meta WHERE key = 'seq_encoding';");
+            for (auto row : qry) table_packed = (string(row.get<const char *>(0)) == "2bit");
+        }
+        if (table_packed != packed_seqs) {
+            fprintf(stderr, "`reads` table stores %s sequences, continuing with that encoding.\n",
+                    table_packed ? "2-bit packed" : "text");
+        }
+        this->packed_seqs = table_packed;
+
+        bool table_hashes = sqlite3_exec(this->db.db_, "SELECT seq1_hashes FROM reads LIMIT 1", nullptr, nullptr,
+                                         nullptr) == SQLITE_OK;
+        if (table_hashes != this->persist_hashes) {
+            fprintf(stderr, "`reads` table was created %s k-mer hashes, continuing that way.\n",
+                    table_hashes ? "with" : "without");
+        }
+        this->persist_hashes = table_hashes;
     }
 
     fprintf(stderr, "Done initializing DB.\n");
@@ -96,17 +111,277 @@ SQLiteManager::SQLiteManager(const string &db_file) {
 }
 
 void SQLiteManager::close() {
-    sqlite3_close(this->db.db_);
+    // Clears the handle, so the database destructor doesn't close it again.
+    this->db.disconnect();
 }
 
-void SQLiteManager::insert_PE(string &R1, string &R2, int &collectiveComp1, int &collectiveComp2) {
+void SQLiteManager::exec(const string &sql) {
+    this->rc = sqlite3_exec(this->db.db_, sql.c_str(), nullptr, nullptr, &this->zErrMsg);
+    if (this->rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", this->zErrMsg);
+        sqlite3_free(this->zErrMsg);
+    }
+}
+
+void SQLiteManager::create_reads_index() {
+    string _sqlite_create_index = "CREATE INDEX IF NOT EXISTS components_index ON reads (seq1_original_component, seq2_original_component);";
+    if (this->partitioning_mode == 2) {
+        _sqlite_create_index = "CREATE INDEX IF NOT EXISTS components_index ON reads (seq1_collective_component);";
+    }
+
+    auto t1 = chrono::high_resolution_clock::now();
+    this->exec(_sqlite_create_index);
+    if (this->rc == SQLITE_OK) {
+        auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+        fprintf(stderr, "DB Index created successfully in %.1fs.\n", sec);
+    }
+}
 
-    const string _sqlite_insert = "INSERT INTO reads"
-                                  "(PE_seq1, PE_seq2, seq1_collective_component, seq2_collective_component, seq1_original_component, seq2_original_component)"
-                                  "VALUES"
-                                  "('" + R1 + "', '" + R2 + "', " + to_string(collectiveComp1) + ", " +
-                                  to_string(collectiveComp2) + ", 0, 0);";
+void SQLiteManager::begin_bulk_load(int partitioning_mode, const string &journal_mode, uint64_t transaction_rows) {
+    this->partitioning_mode = partitioning_mode;
+    this->transaction_rows = transaction_rows;
 
-    this->rc = sqlite3_exec(this->db.db_, _sqlite_insert.c_str(), this->callback, 0, &this->zErrMsg);
+    this->exec(this->checkpointing ? "PRAGMA synchronous = NORMAL;" : "PRAGMA synchronous = OFF;");
+    this->exec("PRAGMA journal_mode = " + (this->checkpointing ? string("WAL") : journal_mode) + ";");
+    this->exec("PRAGMA temp_store = MEMORY;");
+    this->exec("PRAGMA cache_size = -1048576;");
+
+    const char *_sqlite_insert = "INSERT INTO reads (PE_seq1, PE_seq2, seq1_original_component, seq2_original_component) VALUES (?,?,?,?);";
+    if (partitioning_mode == 2) {
+        _sqlite_insert = "INSERT INTO reads (PE_seq1, PE_seq2, seq1_collective_component, seq2_collective_component, seq1_original_component, seq2_original_component) VALUES (?,?,?,?,0,0);";
+    }
+    if (partitioning_mode == 2 && this->persist_hashes) {
+        _sqlite_insert = "INSERT INTO reads (PE_seq1, PE_seq2, seq1_collective_component, seq2_collective_component, seq1_original_component, seq2_original_component, seq1_hashes, seq2_hashes) VALUES (?,?,?,?,0,0,?,?);";
+    }
+
+    this->rc = sqlite3_prepare_v2(this->db.db_, _sqlite_insert, -1, &this->insert_stmt, nullptr);
+    if (this->rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(this->db.db_));
+        exit(1);
+    }
+
+    this->bulk_rows = 0;
+    this->rows_in_transaction = 0;
+    this->last_row_id = 0;
+    {
+        sqlite3pp::query qry(this->db, "SELECT IFNULL(MAX(ID), 0) FROM reads;");
+        for (auto row : qry) this->last_row_id = row.get<long long>(0);
+    }
+    this->bulk_start = chrono::high_resolution_clock::now();
+    this->exec("BEGIN TRANSACTION;");
+}
+
+void SQLiteManager::bulk_insert(const PE_row &row) {
+    if (this->packed_seqs) {
+        // The buffers only grow, the bound BLOBs are the bytes pack() wrote.
+        size_t max1 = seqEncoder::max_packed_size(row.seq1.size()), max2 = seqEncoder::max_packed_size(row.seq2.size());
+        if (this->packed_seq1.size() < max1) this->packed_seq1.resize(max1);
+        if (this->packed_seq2.size() < max2) this->packed_seq2.resize(max2);
+        size_t size1 = seqEncoder::pack(row.seq1.data(), row.seq1.size(), this->packed_seq1.data());
+        size_t size2 = seqEncoder::pack(row.seq2.data(), row.seq2.size(), this->packed_seq2.data());
+        sqlite3_bind_blob(this->insert_stmt, 1, this->packed_seq1.data(), size1, SQLITE_STATIC);
+        sqlite3_bind_blob(this->insert_stmt, 2, this->packed_seq2.data(), size2, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_text(this->insert_stmt, 1, row.seq1.data(), row.seq1.size(), SQLITE_STATIC);
+        sqlite3_bind_text(this->insert_stmt, 2, row.seq2.data(), row.seq2.size(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int64(this->insert_stmt, 3, row.comp1);
+    sqlite3_bind_int64(this->insert_stmt, 4, row.comp2);
+    if (this->partitioning_mode == 2 && this->persist_hashes) {
+        sqlite3_bind_blob(this->insert_stmt, 5, row.hashes1.data(), row.hashes1.size(), SQLITE_STATIC);
+        sqlite3_bind_blob(this->insert_stmt, 6, row.hashes2.data(), row.hashes2.size(), SQLITE_STATIC);
+    }
+
+    int retVal = sqlite3_step(this->insert_stmt);
+    if (retVal != SQLITE_DONE) {
+        fprintf(stderr, "Insertion Failed! %d: %s\n", retVal, sqlite3_errmsg(this->db.db_));
+    } else {
+        this->last_row_id = sqlite3_last_insert_rowid(this->db.db_);
+    }
+    sqlite3_reset(this->insert_stmt);
+
+    this->bulk_rows++;
+    if (++this->rows_in_transaction >= this->transaction_rows && !this->checkpointing) this->commit();
+}
+
+void SQLiteManager::bulk_insert(const std::pmr::vector<PE_row> &rows) {
+    for (const auto &row : rows) this->bulk_insert(row);
+}
+
+void SQLiteManager::commit() {
+    this->exec("COMMIT TRANSACTION;");
+    this->exec("BEGIN TRANSACTION;");
+    this->rows_in_transaction = 0;
+}
 
-}
\ No newline at end of file
+double SQLiteManager::rows_per_sec() {
+    double sec = chrono::duration<double>(chrono::high_resolution_clock::now() - this->bulk_start).count();
+    return sec > 0 ? this->bulk_rows / sec : 0;
+}
+
+void SQLiteManager::end_bulk_load() {
+    this->exec("COMMIT TRANSACTION;");
+    sqlite3_finalize(this->insert_stmt);
+    this->insert_stmt = nullptr;
+
+    fprintf(stderr, "Bulk loaded %lu rows (%.0f rows/s), building the components index ...\n",
+            (unsigned long) this->bulk_rows, this->rows_per_sec());
+    this->create_reads_index();
+    this->exec("ANALYZE;");
+}
+
+bool SQLiteManager::read_hashes(const sqlite3pp::query::rows &row, int idx, vector<uint64_t> &hashes) {
+    if (row.column_type(idx) != SQLITE_BLOB) return false;
+    size_t bytes = row.column_bytes(idx);
+    hashes.resize(bytes / sizeof(uint64_t));
+    if (bytes) memcpy(hashes.data(), row.get<void const *>(idx), hashes.size() * sizeof(uint64_t));
+    return true;
+}
+
+void SQLiteManager::set_meta(const string &key, const string &value) {
+    this->exec("CREATE TABLE IF NOT EXISTS `meta` (`key` TEXT PRIMARY KEY, `value` TEXT);");
+    sqlite3pp::command cmd(this->db, "INSERT OR REPLACE INTO meta VALUES (?, ?);");
+    cmd.bind(1, key, sqlite3pp::copy);
+    cmd.bind(2, value, sqlite3pp::copy);
+    cmd.execute();
+}
+
+string SQLiteManager::get_meta(const string &key) {
+    string value;
+    if (sqlite3_exec(this->db.db_, "SELECT 1 FROM meta LIMIT 1", nullptr, nullptr, nullptr) != SQLITE_OK) return value;
+    sqlite3pp::query qry(this->db, "SELECT value FROM meta WHERE key = ?;");
+    qry.bind(1, key, sqlite3pp::copy);
+    for (auto row : qry) {
+        auto text = row.get<const char *>(0);
+        value = text ? text : "";
+    }
+    return value;
+}
+
+void SQLiteManager::begin_components_update() {
+    this->exec("PRAGMA temp_store = FILE;");
+    this->exec("CREATE TEMP TABLE IF NOT EXISTS `original_components` ("
+               "`ID` INTEGER PRIMARY KEY, `comp1` INTEGER NOT NULL DEFAULT 0, `comp2` INTEGER NOT NULL DEFAULT 0);");
+    this->exec("DELETE FROM original_components;");
+
+    // Mates are staged independently, the second one to arrive completes the row.
+    for (int R_ID = 1; R_ID <= 2; R_ID++) {
+        string comp = "comp" + to_string(R_ID);
+        string _sqlite_stage = "INSERT INTO original_components (ID, " + comp + ") VALUES (?,?) "
+                               "ON CONFLICT(ID) DO UPDATE SET " + comp + " = excluded." + comp + ";";
+        this->rc = sqlite3_prepare_v2(this->db.db_, _sqlite_stage.c_str(), -1, &this->stage_stmt[R_ID], nullptr);
+        if (this->rc != SQLITE_OK) {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(this->db.db_));
+            exit(1);
+        }
+    }
+
+    this->staged_rows = 0;
+    this->exec("BEGIN TRANSACTION;");
+}
+
+void SQLiteManager::stage_component(int R_ID, int64_t ID, int64_t comp) {
+    sqlite3_stmt *stmt = this->stage_stmt[R_ID];
+    sqlite3_bind_int64(stmt, 1, ID);
+    sqlite3_bind_int64(stmt, 2, comp);
+    int retVal = sqlite3_step(stmt);
+    if (retVal != SQLITE_DONE) {
+        fprintf(stderr, "Staging Failed! %d: %s\n", retVal, sqlite3_errmsg(this->db.db_));
+    }
+    sqlite3_reset(stmt);
+    this->staged_rows++;
+}
+
+uint64_t SQLiteManager::end_components_update() {
+    for (int R_ID = 1; R_ID <= 2; R_ID++) {
+        sqlite3_finalize(this->stage_stmt[R_ID]);
+        this->stage_stmt[R_ID] = nullptr;
+    }
+
+    auto t1 = chrono::high_resolution_clock::now();
+    // UPDATE ... FROM needs SQLite 3.33, older versions update through correlated subqueries.
+    if (sqlite3_libversion_number() >= 3033000) {
+        this->exec("UPDATE reads SET seq1_original_component = o.comp1, seq2_original_component = o.comp2 "
+                   "FROM original_components AS o WHERE reads.ID = o.ID;");
+    } else {
+        this->exec("UPDATE reads SET (seq1_original_component, seq2_original_component) = "
+                   "(SELECT comp1, comp2 FROM original_components AS o WHERE o.ID = reads.ID) "
+                   "WHERE ID IN (SELECT ID FROM original_components);");
+    }
+    auto updated = (uint64_t) sqlite3_changes(this->db.db_);
+    this->exec("COMMIT TRANSACTION;");
+    this->exec("DROP TABLE original_components;");
+
+    auto sec = chrono::duration<double>(chrono::high_resolution_clock::now() - t1).count();
+    fprintf(stderr, "Original components of %lu reads written back (%lu staged labels) in %.1fs.\n",
+            (unsigned long) updated, (unsigned long) this->staged_rows, sec);
+    return updated;
+}
+
+void SQLiteManager::enable_checkpoints() {
+    this->checkpointing = true;
+    this->exec("CREATE TABLE IF NOT EXISTS `checkpoint` ("
+               "`id` INTEGER PRIMARY KEY CHECK (`id` = 1), `chunk` INTEGER, `pairs` INTEGER, `offset1` INTEGER, "
+               "`offset2` INTEGER, `last_row_id` INTEGER, `counters` TEXT);");
+}
+
+void SQLiteManager::checkpoint(const run_checkpoint &state) {
+    sqlite3pp::command cmd(this->db, "INSERT OR REPLACE INTO checkpoint VALUES (1, ?, ?, ?, ?, ?, ?);");
+    cmd.bind(1, (long long) state.chunk);
+    cmd.bind(2, (long long) state.pairs);
+    cmd.bind(3, (long long) state.offset1);
+    cmd.bind(4, (long long) state.offset2);
+    cmd.bind(5, (long long) this->last_row_id);
+    cmd.bind(6, state.counters, sqlite3pp::copy);
+    if (cmd.execute() != SQLITE_OK) {
+        fprintf(stderr, "Checkpoint Failed! %s\n", sqlite3_errmsg(this->db.db_));
+    }
+    if (this->rows_in_transaction >= this->transaction_rows) this->commit();
+}
+
+bool SQLiteManager::resume_checkpoint(run_checkpoint &state) {
+    long long last_row_id = 0;
+    bool found = false;
+    {
+        sqlite3pp::query qry(this->db, "SELECT chunk, pairs, offset1, offset2, last_row_id, counters FROM checkpoint;");
+        for (auto row : qry) {
+            state.chunk = row.get<long long>(0);
+            state.pairs = row.get<long long>(1);
+            state.offset1 = row.get<long long>(2);
+            state.offset2 = row.get<long long>(3);
+            last_row_id = row.get<long long>(4);
+            auto counters = row.get<const char *>(5);
+            state.counters = counters ? counters : "";
+            found = true;
+        }
+    }
+
+    // Rows without any checkpoint come from a run that wasn't resumable, there's nothing to continue from.
+    if (!found) {
+        long long rows = 0;
+        sqlite3pp::query qry(this->db, "SELECT count(*) FROM reads;");
+        for (auto row : qry) rows = row.get<long long>(0);
+        if (rows > 0) {
+            fprintf(stderr, "Refusing to resume: the reads table has %lld rows but no checkpoint, "
+                            "remove the database or run without --resume.\n", rows);
+            exit(1);
+        }
+        return false;
+    }
+
+    // Rows past the checkpoint (none, unless they were written without checkpoints) are dropped,
+    // and the IDs continue right after it.
+    this->exec("DELETE FROM reads WHERE ID > " + to_string(last_row_id) + ";");
+    fprintf(stderr, "Dropped %d rows written after the last checkpoint.\n", sqlite3_changes(this->db.db_));
+    this->exec("UPDATE sqlite_sequence SET seq = " + to_string(last_row_id) + " WHERE name = 'reads';");
+    return true;
+}
+
+bool SQLiteManager::read_seq(const sqlite3pp::query::rows &row, int idx, string &seq) {
+    if (row.column_type(idx) == SQLITE_BLOB) {
+        return seqEncoder::unpack((const uint8_t *) row.get<void const *>(idx), row.column_bytes(idx), seq);
+    }
+    auto text = row.get<char const *>(idx);
+    seq.assign(text ? text : "");
+    return true;
+}